@@ -14,5 +14,6 @@
 #include "py_population_view.h"
 #include "py_projection.h"
 #include "py_random.h"
+#include "py_session.h"
 
 //#include "testing.h"
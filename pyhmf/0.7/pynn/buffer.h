@@ -0,0 +1,31 @@
+#pragma once
+
+#include "pyhmf/boost_python.h"
+
+/// RAII wrapper of a buffer obtained through the python buffer protocol
+class Buffer
+{
+public:
+	explicit Buffer(PyObject* obj, int flags = PyBUF_C_CONTIGUOUS | PyBUF_FORMAT)
+	{
+		if (PyObject_GetBuffer(obj, &mView, flags) != 0) {
+			bp::throw_error_already_set();
+		}
+	}
+
+	~Buffer()
+	{
+		PyBuffer_Release(&mView);
+	}
+
+	Py_buffer const& view() const
+	{
+		return mView;
+	}
+
+private:
+	Buffer(Buffer const&);
+	Buffer& operator=(Buffer const&);
+
+	Py_buffer mView;
+};
@@ -0,0 +1,149 @@
+#include "distance.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace distance {
+
+namespace {
+
+// Number of columns processed at once. The corresponding part of the three
+// rows of b (12 KiB) stays in the L1 cache while all rows of a are processed.
+size_t const block = 512;
+
+// The loops below operate on contiguous rows without branches in the inner
+// loop, such that they are vectorized by the compiler. The order of
+// operations equals the PyNN reference implementation, thus results are
+// identical.
+inline void accumulate(double a, double const* __restrict b, double* __restrict acc,
+                       size_t n, double period)
+{
+	if (period > 0.) {
+		for (size_t j = 0; j < n; ++j) {
+			double d = std::fabs(a - b[j]);
+			d = std::min(d, period - d);
+			acc[j] += d * d;
+		}
+	} else {
+		for (size_t j = 0; j < n; ++j) {
+			double const d = a - b[j];
+			acc[j] += d * d;
+		}
+	}
+}
+
+template <typename T>
+inline void store(double const* __restrict acc, T* __restrict out, size_t n)
+{
+	for (size_t j = 0; j < n; ++j) {
+		out[j] = static_cast<T>(std::sqrt(acc[j]));
+	}
+}
+
+} // anonymous namespace
+
+Metric::Metric() : scale(1.)
+{
+	for (size_t axis = 0; axis < 3; ++axis) {
+		axes[axis] = true;
+		offset[axis] = 0.;
+		period[axis] = 0.;
+	}
+}
+
+size_t Metric::dimensions() const
+{
+	return std::count(axes, axes + 3, true);
+}
+
+Positions::Positions(double const* d, size_t s) : data(d), size(s)
+{
+}
+
+double const* Positions::row(size_t axis) const
+{
+	return data + axis * size;
+}
+
+std::vector<double> transform(Metric const& metric, Positions const& b)
+{
+	std::vector<double> result(3 * b.size);
+	for (size_t axis = 0; axis < 3; ++axis) {
+		double const* in = b.row(axis);
+		double* out = result.data() + axis * b.size;
+		double const offset = metric.offset[axis];
+		for (size_t j = 0; j < b.size; ++j) {
+			out[j] = metric.scale * (in[j] + offset);
+		}
+	}
+	return result;
+}
+
+template <typename T>
+void tile(Metric const& metric,
+          Positions const& a,
+          Positions const& b,
+          size_t i0, size_t i1,
+          size_t j0, size_t j1,
+          T* out,
+          size_t ld,
+          bool expand,
+          size_t plane)
+{
+	double acc[block];
+
+	for (size_t jb = j0; jb < j1; jb += block) {
+		size_t const n = std::min(block, j1 - jb);
+
+		for (size_t i = i0; i < i1; ++i) {
+			T* const row = out + (i - i0) * ld + (jb - j0);
+
+			if (!expand) {
+				std::fill(acc, acc + n, 0.);
+			}
+
+			size_t k = 0;
+			for (size_t axis = 0; axis < 3; ++axis) {
+				if (!metric.axes[axis]) {
+					continue;
+				}
+
+				if (expand) {
+					std::fill(acc, acc + n, 0.);
+				}
+				accumulate(a.row(axis)[i], b.row(axis) + jb, acc, n, metric.period[axis]);
+				if (expand) {
+					store(acc, row + k * plane, n);
+				}
+				++k;
+			}
+
+			if (!expand) {
+				store(acc, row, n);
+			}
+		}
+	}
+}
+
+template <typename T>
+void distances(Metric const& metric, Positions const& a, Positions const& b, T* out,
+               bool expand)
+{
+	std::vector<double> const tb = transform(metric, b);
+	tile(metric, a, Positions(tb.data(), b.size), 0, a.size, 0, b.size, out, b.size,
+	     expand, a.size * b.size);
+}
+
+template void tile<double>(
+    Metric const&, Positions const&, Positions const&,
+    size_t, size_t, size_t, size_t, double*, size_t, bool, size_t);
+template void tile<float>(
+    Metric const&, Positions const&, Positions const&,
+    size_t, size_t, size_t, size_t, float*, size_t, bool, size_t);
+
+template void distances<double>(
+    Metric const&, Positions const&, Positions const&, double*, bool);
+template void distances<float>(
+    Metric const&, Positions const&, Positions const&, float*, bool);
+
+} // distance
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+/// Distance calculations of a PyNN Space on positions in (3, n) layout, i.e.
+/// three contiguous rows holding the x, y and z coordinates.
+namespace distance {
+
+/// Metric of a PyNN Space: distances are calculated between a and
+/// scale * (b + offset) along the selected axes, using the minimum image
+/// along axes with periodic boundaries.
+struct Metric
+{
+	Metric();
+
+	/// Number of selected axes
+	size_t dimensions() const;
+
+	bool axes[3];
+	double scale;
+	double offset[3];
+	/// Extent of the periodic boundaries along each axis, 0 if not periodic.
+	double period[3];
+};
+
+/// Non-owning view of positions in (3, n) layout
+struct Positions
+{
+	Positions(double const* data, size_t size);
+
+	double const* row(size_t axis) const;
+
+	double const* data;
+	size_t size;
+};
+
+/// Applies scale and offset of the metric to the positions b. The result
+/// (in (3, n) layout) is the second argument of tile().
+std::vector<double> transform(Metric const& metric, Positions const& b);
+
+/// Calculates the distances between a[i0, i1) and the transformed positions
+/// b[j0, j1) into out, which has a row stride of ld. Element (i, j) is written
+/// to out[(i - i0) * ld + j - j0].
+/// In expand mode the distances along each selected axis are written instead,
+/// the planes for the different axes are plane elements apart.
+template <typename T>
+void tile(Metric const& metric,
+          Positions const& a,
+          Positions const& b,
+          size_t i0, size_t i1,
+          size_t j0, size_t j1,
+          T* out,
+          size_t ld,
+          bool expand = false,
+          size_t plane = 0);
+
+/// Calculates the full (a.size, b.size) distance matrix, or in expand mode
+/// the (dimensions(), a.size, b.size) array of distances along each axis.
+template <typename T>
+void distances(Metric const& metric, Positions const& a, Positions const& b, T* out,
+               bool expand = false);
+
+} // distance
@@ -3,11 +3,18 @@
 #include <limits>
 #include <fstream>
 
+#include <boost/make_shared.hpp>
 #include <boost/python/stl_iterator.hpp>
+#include <boost/serialization/string.hpp>
+#include <boost/serialization/utility.hpp>
+#include <boost/serialization/vector.hpp>
 #include "pyhmf/boost_python.h"
 #include "pyhmf/objectstore.h"
 #include "euter/exceptions.h"
 #include "euter/metadata.h"
+#include "recording.h"
+#include "labels.h"
+#include "rngs.h"
 
 #include "marocco/mapping.h"
 
@@ -43,24 +50,48 @@ int num_processes() {
 int clear()
 {
 	resetStore();
+	labels::clear();
 	return 0;
 }
 
-// special user-side implementations
-int run(double runtime)
-{
-	auto store = getStore();
+namespace {
 
+void execute(ObjectStore& store, double runtime)
+{
 	store.run(runtime);
 
 	marocco::mapping::run(store);
 
 	// check the result
 	store.check();
+}
+
+} // anonymous namespace
+
+// special user-side implementations
+int run(double runtime)
+{
+	recording::commit();
+
+	auto store = getStore();
+
+	execute(store, runtime);
 
 	return 1;
 }
 
+PyRunHandle run_async(double runtime)
+{
+	// the selection is written to the cell parameters before the copy
+	recording::commit();
+
+	boost::shared_ptr<ObjectStore> const store = boost::make_shared<ObjectStore>(getStore());
+
+	return PyRunHandle::_start(runtime, [store, runtime]() {
+		execute(*store, runtime);
+	});
+}
+
 
 // we have to override this in python <= extra arguments
 int setup(bp::tuple args,
@@ -108,6 +139,7 @@ int setup(bp::tuple args,
 	}
 
 	resetStore(); // clear all data
+	labels::clear();
 	getStore().setup(settings, metadata);
 	return 1;
 }
@@ -125,11 +157,13 @@ int end(bool) {
 	// Due to the early writeout in run() the file format is also not
 	// configurable (but the lower layers do not support this either).
 	resetStore();
+	labels::clear();
 	return 1;
 }
 
 void dumpAsXml(std::string filename)
 {
+	recording::commit();
 	std::ofstream out(filename);
 	boost::archive::xml_oarchive ar(out);
 	ar << boost::serialization::make_nvp("object", getStore());
@@ -137,8 +171,12 @@ void dumpAsXml(std::string filename)
 
 void dumpAsBinary(std::string filename)
 {
+	recording::commit();
 	std::ofstream out(filename);
 	boost::archive::binary_oarchive ar(out);
 	ar << boost::serialization::make_nvp("object", getStore());
+	// followed by the states of the RNGs, such that a run can be continued
+	std::vector<std::pair<std::string, std::string> > const states = rngs::states();
+	ar << boost::serialization::make_nvp("rngs", states);
 }
 
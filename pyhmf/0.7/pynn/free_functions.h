@@ -5,6 +5,8 @@
 
 #include <string>
 
+#include "py_run_handle.h"
+
 // we have to override this in python <= extra arguments
 int setup(bp::tuple args,
           bp::dict extra_params = SentinelKeeper::emptyPyDict);
@@ -37,8 +39,18 @@ int num_processes();
 // Run the emulation for simtime ms.
 int run(double simtime);
 
+// Start run(simtime) on a worker thread without the GIL, the returned handle
+// allows to wait for its result. The metadata passed to setup() (e.g. the
+// PyMarocco object) is used by the worker and must not be touched until the
+// run is done.
+PyRunHandle run_async(double simtime);
+
 // Dumps the Object Store to a file
 void dumpAsXml(std::string filename);
+// The binary dump is followed by the states of all live RNGs in order of
+// creation, as std::vector<std::pair<std::string, std::string> > of identity
+// (see rngs.h) and state. The state of an RNG is restored by passing it to
+// set_state() of an RNG with the same identity.
 void dumpAsBinary(std::string filename);
 
 
@@ -0,0 +1,24 @@
+#pragma once
+
+#include "pyhmf/boost_python.h"
+
+/// Releases the GIL for the lifetime of the object, such that other python
+/// threads run meanwhile. No python objects may be used in its scope.
+class ReleaseGIL
+{
+public:
+	ReleaseGIL() : mState(PyEval_SaveThread())
+	{
+	}
+
+	~ReleaseGIL()
+	{
+		PyEval_RestoreThread(mState);
+	}
+
+private:
+	ReleaseGIL(ReleaseGIL const&);
+	ReleaseGIL& operator=(ReleaseGIL const&);
+
+	PyThreadState* mState;
+};
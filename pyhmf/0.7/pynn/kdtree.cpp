@@ -0,0 +1,169 @@
+#include "kdtree.h"
+
+#include <algorithm>
+#include <numeric>
+
+#include "positions.h"
+
+namespace positions {
+
+KDTree::KDTree(boost::shared_ptr<Positions const> const& positions) :
+	mPositions(positions),
+	mCells(positions->size()),
+	mAxis(positions->size())
+{
+	std::iota(mCells.begin(), mCells.end(), 0);
+	build(0, mCells.size());
+}
+
+void KDTree::build(size_t begin, size_t end)
+{
+	if (end - begin <= leaf_size) {
+		return;
+	}
+
+	// split along the axis of largest extent
+	size_t axis = 0;
+	double extent = -1.;
+	for (size_t a = 0; a < 3; ++a) {
+		double const* coord = mPositions->row(a);
+		auto const minmax = std::minmax_element(
+			mCells.begin() + begin, mCells.begin() + end,
+			[coord](size_t lhs, size_t rhs) { return coord[lhs] < coord[rhs]; });
+		double const e = coord[*minmax.second] - coord[*minmax.first];
+		if (e > extent) {
+			axis = a;
+			extent = e;
+		}
+	}
+
+	size_t const median = begin + (end - begin) / 2;
+	double const* coord = mPositions->row(axis);
+	std::nth_element(
+		mCells.begin() + begin, mCells.begin() + median, mCells.begin() + end,
+		[coord](size_t lhs, size_t rhs) { return coord[lhs] < coord[rhs]; });
+	mAxis[median] = axis;
+
+	build(begin, median);
+	build(median + 1, end);
+}
+
+double KDTree::distance2(size_t cell, double const* point) const
+{
+	double result = 0.;
+	for (size_t axis = 0; axis < 3; ++axis) {
+		double const d = mPositions->row(axis)[cell] - point[axis];
+		result += d * d;
+	}
+	return result;
+}
+
+void KDTree::searchNearest(size_t begin, size_t end, double const* point, size_t k,
+                           mask_type const* mask, std::vector<candidate_type>& heap) const
+{
+	// heap is a max-heap of the best k candidates found so far, comparing
+	// pairs breaks ties in favour of smaller indices
+	auto consider = [&](size_t cell) {
+		if (mask && !(*mask)[cell]) {
+			return;
+		}
+		candidate_type const c(distance2(cell, point), cell);
+		if (heap.size() < k) {
+			heap.push_back(c);
+			std::push_heap(heap.begin(), heap.end());
+		} else if (c < heap.front()) {
+			std::pop_heap(heap.begin(), heap.end());
+			heap.back() = c;
+			std::push_heap(heap.begin(), heap.end());
+		}
+	};
+
+	if (end - begin <= leaf_size) {
+		for (size_t ii = begin; ii < end; ++ii) {
+			consider(mCells[ii]);
+		}
+		return;
+	}
+
+	size_t const median = begin + (end - begin) / 2;
+	size_t const cell = mCells[median];
+	size_t const axis = mAxis[median];
+	double const diff = point[axis] - mPositions->row(axis)[cell];
+
+	consider(cell);
+
+	// descend into the half containing the point first, the other one can only
+	// contain better candidates if the splitting plane is close enough
+	if (diff < 0.) {
+		searchNearest(begin, median, point, k, mask, heap);
+		if (heap.size() < k || diff * diff <= heap.front().first) {
+			searchNearest(median + 1, end, point, k, mask, heap);
+		}
+	} else {
+		searchNearest(median + 1, end, point, k, mask, heap);
+		if (heap.size() < k || diff * diff <= heap.front().first) {
+			searchNearest(begin, median, point, k, mask, heap);
+		}
+	}
+}
+
+void KDTree::searchWithin(size_t begin, size_t end, double const* point, double radius2,
+                          mask_type const* mask, std::vector<size_t>& result) const
+{
+	auto consider = [&](size_t cell) {
+		if ((!mask || (*mask)[cell]) && distance2(cell, point) <= radius2) {
+			result.push_back(cell);
+		}
+	};
+
+	if (end - begin <= leaf_size) {
+		for (size_t ii = begin; ii < end; ++ii) {
+			consider(mCells[ii]);
+		}
+		return;
+	}
+
+	size_t const median = begin + (end - begin) / 2;
+	size_t const cell = mCells[median];
+	size_t const axis = mAxis[median];
+	double const diff = point[axis] - mPositions->row(axis)[cell];
+
+	consider(cell);
+
+	if (diff <= 0. || diff * diff <= radius2) {
+		searchWithin(begin, median, point, radius2, mask, result);
+	}
+	if (diff >= 0. || diff * diff <= radius2) {
+		searchWithin(median + 1, end, point, radius2, mask, result);
+	}
+}
+
+std::vector<size_t> KDTree::nearest(double const* point, size_t k,
+                                    mask_type const* mask) const
+{
+	std::vector<candidate_type> heap;
+	if (k > 0) {
+		heap.reserve(k);
+		searchNearest(0, mCells.size(), point, k, mask, heap);
+	}
+	std::sort_heap(heap.begin(), heap.end());
+
+	std::vector<size_t> result(heap.size());
+	for (size_t ii = 0; ii < heap.size(); ++ii) {
+		result[ii] = heap[ii].second;
+	}
+	return result;
+}
+
+std::vector<size_t> KDTree::within(double const* point, double radius,
+                                   mask_type const* mask) const
+{
+	std::vector<size_t> result;
+	if (radius >= 0.) {
+		searchWithin(0, mCells.size(), point, radius * radius, mask, result);
+	}
+	std::sort(result.begin(), result.end());
+	return result;
+}
+
+} // positions
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <utility>
+#include <vector>
+#include <boost/dynamic_bitset.hpp>
+#include <boost/shared_ptr.hpp>
+
+namespace positions {
+
+class Positions;
+
+/// Static k-d tree over the cell positions of a population.
+///
+/// The tree is stored implicitly in a permutation of the cell indices: the
+/// median of each range splits it along the axis of largest extent, ranges of
+/// at most leaf_size cells are scanned linearly.
+/// Queries optionally take a mask (of population size) restricting the
+/// considered cells, such that all views of a population share one tree.
+class KDTree
+{
+public:
+	typedef boost::dynamic_bitset<> mask_type;
+
+	explicit KDTree(boost::shared_ptr<Positions const> const& positions);
+
+	/// Returns the (at most) k cells closest to point, ordered by distance.
+	/// Cells at equal distance are ordered by index.
+	std::vector<size_t> nearest(double const* point, size_t k,
+	                            mask_type const* mask = nullptr) const;
+
+	/// Returns all cells at most radius away from point in ascending order.
+	std::vector<size_t> within(double const* point, double radius,
+	                           mask_type const* mask = nullptr) const;
+
+private:
+	// squared distance and index of a cell
+	typedef std::pair<double, size_t> candidate_type;
+
+	void build(size_t begin, size_t end);
+
+	double distance2(size_t cell, double const* point) const;
+
+	void searchNearest(size_t begin, size_t end, double const* point, size_t k,
+	                   mask_type const* mask, std::vector<candidate_type>& heap) const;
+
+	void searchWithin(size_t begin, size_t end, double const* point, double radius2,
+	                  mask_type const* mask, std::vector<size_t>& result) const;
+
+	static size_t const leaf_size = 8;
+
+	boost::shared_ptr<Positions const> mPositions;
+	std::vector<size_t> mCells;
+	// split axis of the node stored at the median of each range
+	std::vector<unsigned char> mAxis;
+};
+
+} // positions
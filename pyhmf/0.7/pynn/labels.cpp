@@ -0,0 +1,93 @@
+#include "labels.h"
+
+#include <unordered_map>
+#include <boost/weak_ptr.hpp>
+
+#include "pyhmf/objectstore.h"
+
+namespace labels {
+
+namespace {
+
+template <typename T>
+class Index
+{
+public:
+	void add(boost::shared_ptr<T> const& object, std::string const& label)
+	{
+		if (label.empty()) {
+			return;
+		}
+		// keep the first object with this label unless it vanished
+		boost::weak_ptr<T>& entry = mEntries[label];
+		if (entry.expired()) {
+			entry = object;
+		}
+	}
+
+	boost::shared_ptr<T> get(std::string const& label)
+	{
+		auto it = mEntries.find(label);
+		if (it == mEntries.end()) {
+			return boost::shared_ptr<T>();
+		}
+		boost::shared_ptr<T> object = it->second.lock();
+		if (!object) {
+			mEntries.erase(it);
+		}
+		return object;
+	}
+
+	void clear()
+	{
+		mEntries.clear();
+	}
+
+private:
+	std::unordered_map<std::string, boost::weak_ptr<T> > mEntries;
+};
+
+// Objects are indexed in the session they were created in, lookups by label
+// use the current session.
+Index<euter::Population>& populations(Session& session)
+{
+	return session.registry<Index<euter::Population> >();
+}
+
+Index<euter::Projection>& projections(Session& session)
+{
+	return session.registry<Index<euter::Projection> >();
+}
+
+} // anonymous namespace
+
+void add(boost::shared_ptr<euter::Population> const& population, std::string const& label)
+{
+	boost::shared_ptr<Session> const owner = Session::of(population.get());
+	populations(*owner).add(population, label);
+}
+
+void add(boost::shared_ptr<euter::Projection> const& projection, std::string const& label)
+{
+	boost::shared_ptr<Session> const owner = Session::of(projection.get());
+	projections(*owner).add(projection, label);
+}
+
+boost::shared_ptr<euter::Population> population(std::string const& label)
+{
+	return populations(*Session::current()).get(label);
+}
+
+boost::shared_ptr<euter::Projection> projection(std::string const& label)
+{
+	return projections(*Session::current()).get(label);
+}
+
+void clear()
+{
+	Session& session = *Session::current();
+	populations(session).clear();
+	projections(session).clear();
+}
+
+} // labels
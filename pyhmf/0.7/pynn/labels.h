@@ -0,0 +1,31 @@
+#pragma once
+
+#include <string>
+#include <boost/shared_ptr.hpp>
+
+namespace euter {
+class Population;
+class Projection;
+}
+
+/// Populations and projections of the store indexed by their label.
+///
+/// Lookups are hash table accesses instead of scans over all objects. Objects
+/// are referenced weakly, such that the index does not keep them alive. If a
+/// label is used several times, the object created first is found. Every
+/// session has its own index, objects are added to the index of the session
+/// they were created in, lookups and clear() act on the current session.
+namespace labels {
+
+/// Registers a new population or projection, empty labels are ignored.
+void add(boost::shared_ptr<euter::Population> const& population, std::string const& label);
+void add(boost::shared_ptr<euter::Projection> const& projection, std::string const& label);
+
+/// Returns the population or projection with the given label, or null.
+boost::shared_ptr<euter::Population> population(std::string const& label);
+boost::shared_ptr<euter::Projection> projection(std::string const& label);
+
+/// Drops all entries, called whenever the store is reset.
+void clear();
+
+} // labels
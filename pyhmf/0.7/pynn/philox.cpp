@@ -0,0 +1,161 @@
+#include "philox.h"
+
+#include <algorithm>
+
+namespace philox {
+
+namespace {
+
+// Number of blocks generated at once. The rounds below operate on the
+// counters of all lanes in structure-of-arrays layout without branches, such
+// that the 32x32->64 bit multiplications are vectorized by the compiler.
+size_t const lanes = 16;
+
+std::uint32_t const M0 = 0xD2511F53;
+std::uint32_t const M1 = 0xCD9E8D57;
+std::uint32_t const W0 = 0x9E3779B9;
+std::uint32_t const W1 = 0xBB67AE85;
+
+struct Batch
+{
+	std::uint32_t x0[lanes];
+	std::uint32_t x1[lanes];
+	std::uint32_t x2[lanes];
+	std::uint32_t x3[lanes];
+};
+
+inline void rounds(std::uint32_t const* key, Batch& b)
+{
+	std::uint32_t k0 = key[0];
+	std::uint32_t k1 = key[1];
+	for (size_t round = 0; round < 10; ++round) {
+		for (size_t l = 0; l < lanes; ++l) {
+			std::uint64_t const p0 = static_cast<std::uint64_t>(M0) * b.x0[l];
+			std::uint64_t const p1 = static_cast<std::uint64_t>(M1) * b.x2[l];
+			std::uint32_t const y0 = static_cast<std::uint32_t>(p1 >> 32) ^ b.x1[l] ^ k0;
+			std::uint32_t const y2 = static_cast<std::uint32_t>(p0 >> 32) ^ b.x3[l] ^ k1;
+			b.x1[l] = static_cast<std::uint32_t>(p1);
+			b.x3[l] = static_cast<std::uint32_t>(p0);
+			b.x0[l] = y0;
+			b.x2[l] = y2;
+		}
+		k0 += W0;
+		k1 += W1;
+	}
+}
+
+// Generates the blocks with the given indices, the counter of a block is its
+// index followed by the stream.
+inline void generate(std::uint32_t const* key, std::uint32_t const* stream,
+                     std::uint64_t const* blocks, Batch& b)
+{
+	for (size_t l = 0; l < lanes; ++l) {
+		b.x0[l] = static_cast<std::uint32_t>(blocks[l]);
+		b.x1[l] = static_cast<std::uint32_t>(blocks[l] >> 32);
+		b.x2[l] = stream[0];
+		b.x3[l] = stream[1];
+	}
+	rounds(key, b);
+}
+
+inline std::uint64_t join(std::uint32_t lo, std::uint32_t hi)
+{
+	return static_cast<std::uint64_t>(hi) << 32 | lo;
+}
+
+// Applies the distribution to all lanes, value 2 * l + h belongs to half h of
+// block l.
+template <typename Distribution>
+inline void transform(Distribution const& distribution, Batch const& b,
+                      typename Distribution::result_type* out)
+{
+	for (size_t l = 0; l < lanes; ++l) {
+		distribution(join(b.x0[l], b.x1[l]), join(b.x2[l], b.x3[l]), out + 2 * l);
+	}
+}
+
+} // anonymous namespace
+
+Stream::Stream(std::uint64_t seed, std::uint64_t stream)
+{
+	mKey[0] = static_cast<std::uint32_t>(seed);
+	mKey[1] = static_cast<std::uint32_t>(seed >> 32);
+	mStream[0] = static_cast<std::uint32_t>(stream);
+	mStream[1] = static_cast<std::uint32_t>(stream >> 32);
+}
+
+template <typename Distribution>
+void Stream::fill(Distribution const& distribution, std::uint64_t first, size_t n,
+                  typename Distribution::result_type* out) const
+{
+	typedef typename Distribution::result_type result_type;
+
+	Batch b;
+	std::uint64_t blocks[lanes];
+	result_type values[2 * lanes];
+
+	std::uint64_t const end = first + n;
+	for (std::uint64_t block = first / 2; 2 * block < end; block += lanes) {
+		for (size_t l = 0; l < lanes; ++l) {
+			blocks[l] = block + l;
+		}
+		generate(mKey, mStream, blocks, b);
+		transform(distribution, b, values);
+
+		// copy the part of [2 * block, 2 * (block + lanes)) requested
+		std::uint64_t const begin = std::max(first, 2 * block);
+		std::uint64_t const stop = std::min(end, 2 * (block + lanes));
+		std::copy(values + (begin - 2 * block), values + (stop - 2 * block),
+		          out + (begin - first));
+	}
+}
+
+template <typename Distribution>
+void Stream::gather(Distribution const& distribution, std::uint64_t const* positions,
+                    size_t n, typename Distribution::result_type* out) const
+{
+	typedef typename Distribution::result_type result_type;
+
+	Batch b;
+	std::uint64_t blocks[lanes];
+	result_type values[2 * lanes];
+
+	for (size_t ii = 0; ii < n; ii += lanes) {
+		size_t const count = std::min(lanes, n - ii);
+		for (size_t l = 0; l < lanes; ++l) {
+			blocks[l] = l < count ? positions[ii + l] / 2 : 0;
+		}
+		generate(mKey, mStream, blocks, b);
+		transform(distribution, b, values);
+
+		for (size_t l = 0; l < count; ++l) {
+			out[ii + l] = values[2 * l + positions[ii + l] % 2];
+		}
+	}
+}
+
+std::uint64_t Stream::raw(std::uint64_t position) const
+{
+	Batch b;
+	std::uint64_t blocks[lanes] = {};
+	blocks[0] = position / 2;
+	generate(mKey, mStream, blocks, b);
+	return position % 2 ? join(b.x2[0], b.x3[0]) : join(b.x0[0], b.x1[0]);
+}
+
+#define PHILOX_INSTANTIATE(Distribution)                                        \
+	template void Stream::fill<Distribution>(                                   \
+		Distribution const&, std::uint64_t, size_t, Distribution::result_type*) \
+		const;                                                                  \
+	template void Stream::gather<Distribution>(                                 \
+		Distribution const&, std::uint64_t const*, size_t,                      \
+		Distribution::result_type*) const;
+
+PHILOX_INSTANTIATE(transforms::Uniform)
+PHILOX_INSTANTIATE(transforms::Normal)
+PHILOX_INSTANTIATE(transforms::Exponential)
+PHILOX_INSTANTIATE(transforms::Integer)
+
+#undef PHILOX_INSTANTIATE
+
+} // philox
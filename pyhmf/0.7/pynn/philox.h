@@ -0,0 +1,41 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "transforms.h"
+
+/// Counter-based random number generation with Philox4x32-10 (Salmon et al.,
+/// "Parallel random numbers: as easy as 1, 2, 3", SC11).
+///
+/// Each block of 128 random bits is a pure function of the seed, the stream
+/// and the block index. Values can thus be generated in any order and on any
+/// number of threads with identical results. A block yields two values of
+/// every transform, value i of a stream is derived from block i / 2.
+namespace philox {
+
+/// One stream of a seeded generator
+class Stream
+{
+public:
+	Stream(std::uint64_t seed, std::uint64_t stream);
+
+	/// Writes values [first, first + n) of the stream to out.
+	template <typename Distribution>
+	void fill(Distribution const& distribution, std::uint64_t first, size_t n,
+	          typename Distribution::result_type* out) const;
+
+	/// Writes the values at the given positions of the stream to out.
+	template <typename Distribution>
+	void gather(Distribution const& distribution, std::uint64_t const* positions,
+	            size_t n, typename Distribution::result_type* out) const;
+
+	/// Returns the raw 64 bit value at the given position.
+	std::uint64_t raw(std::uint64_t position) const;
+
+private:
+	std::uint32_t mKey[2];
+	std::uint32_t mStream[2];
+};
+
+} // philox
@@ -0,0 +1,159 @@
+#include "positions.h"
+#include "kdtree.h"
+
+#include <map>
+#include <boost/make_shared.hpp>
+#include <boost/weak_ptr.hpp>
+
+#include "pyhmf/boost_python.h"
+#include "errors.h"
+#include "euter/population.h"
+#include "euter/space.h"
+
+using namespace euter;
+
+namespace positions {
+
+namespace {
+
+struct Entry
+{
+	// Populations are owned by the ObjectStore, a weak reference allows to
+	// drop entries of populations that vanished with a reset of the store.
+	boost::weak_ptr<Population> population;
+	boost::shared_ptr<Structure> structure;
+	boost::shared_ptr<Positions const> positions;
+	boost::shared_ptr<KDTree const> index;
+};
+
+typedef std::map<Population const*, Entry> entries_type;
+
+entries_type& entries()
+{
+	static entries_type instance;
+	return instance;
+}
+
+Entry& getEntry(boost::shared_ptr<Population> const& population)
+{
+	entries_type& all = entries();
+
+	auto const it = all.find(population.get());
+	if (it != all.end() && !it->second.population.expired()) {
+		return it->second;
+	}
+
+	// new population, drop stale entries (the address may be reused by the
+	// new population)
+	for (auto jt = all.begin(); jt != all.end();) {
+		if (jt->second.population.expired()) {
+			jt = all.erase(jt);
+		} else {
+			++jt;
+		}
+	}
+
+	Entry& entry = all[population.get()];
+	entry.population = population;
+	// default structure of PyPopulation
+	entry.structure = boost::make_shared<Line>();
+	return entry;
+}
+
+} // anonymous namespace
+
+Positions::Positions(size_t size) : mSize(size), mData(3 * size)
+{
+}
+
+size_t Positions::size() const
+{
+	return mSize;
+}
+
+double const* Positions::x() const
+{
+	return row(0);
+}
+
+double const* Positions::y() const
+{
+	return row(1);
+}
+
+double const* Positions::z() const
+{
+	return row(2);
+}
+
+double const* Positions::row(size_t axis) const
+{
+	return mData.data() + axis * mSize;
+}
+
+double* Positions::row(size_t axis)
+{
+	return mData.data() + axis * mSize;
+}
+
+distance::Positions Positions::view() const
+{
+	return distance::Positions(mData.data(), mSize);
+}
+
+pyublas::numpy_vector<double> extract(bp::object const& positions)
+{
+	bp::object const numpy = bp::import("numpy");
+	bp::object array = numpy.attr("ascontiguousarray")(positions, "float64");
+	if(bp::len(array.attr("shape")) == 1)
+		array = array.attr("reshape")(3, 1);
+
+	bp::object const shape = array.attr("shape");
+	if(bp::len(shape) != 2 || bp::extract<size_t>(shape[0]) != 3)
+		throw PyInvalidDimensionsError("Positions must be given as (3, n) array");
+
+	return bp::extract<pyublas::numpy_vector<double> >(array);
+}
+
+void setStructure(boost::shared_ptr<Population> const& population,
+                  boost::shared_ptr<Structure> const& structure)
+{
+	Entry& entry = getEntry(population);
+	entry.structure = structure;
+	entry.positions.reset();
+	entry.index.reset();
+}
+
+boost::shared_ptr<Positions const> get(boost::shared_ptr<Population> const& population)
+{
+	Entry& entry = getEntry(population);
+	if (!entry.positions) {
+		size_t const n = population->size();
+		auto positions = boost::make_shared<Positions>(n);
+		double* x = positions->row(0);
+		double* y = positions->row(1);
+		double* z = positions->row(2);
+
+		size_t ii = 0;
+		for (auto const& vec : entry.structure->generatePositions(n)) {
+			x[ii] = vec[0];
+			y[ii] = vec[1];
+			z[ii] = vec[2];
+			++ii;
+		}
+		entry.positions = positions;
+	}
+	return entry.positions;
+}
+
+boost::shared_ptr<KDTree const> index(boost::shared_ptr<Population> const& population)
+{
+	boost::shared_ptr<Positions const> const cached = get(population);
+	Entry& entry = getEntry(population);
+	if (!entry.index) {
+		entry.index = boost::make_shared<KDTree>(cached);
+	}
+	return entry.index;
+}
+
+} // positions
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <vector>
+#include <boost/shared_ptr.hpp>
+
+#include "pyhmf/boost_python_fwd.h"
+#include "pyublas.h"
+#include "distance.h"
+
+namespace euter {
+class Population;
+class Structure;
+}
+
+/// Cell positions of all populations.
+///
+/// Positions are generated once per population from the structure it was
+/// created with and kept in structure-of-arrays layout, such that all users
+/// (nearest(), save_positions(), distance calculations) share one generation.
+namespace positions {
+
+class KDTree;
+
+/// Positions of all cells of a population in (3, n) layout, i.e. separate
+/// contiguous arrays for the x, y and z coordinates.
+class Positions
+{
+public:
+	explicit Positions(size_t size);
+
+	size_t size() const;
+
+	double const* x() const;
+	double const* y() const;
+	double const* z() const;
+	double const* row(size_t axis) const;
+	double* row(size_t axis);
+
+	/// View usable with the distance kernels
+	distance::Positions view() const;
+
+private:
+	size_t mSize;
+	std::vector<double> mData;
+};
+
+/// Returns positions given from Python as contiguous float64 array in (3, n)
+/// layout, a single position may be given as sequence of three coordinates.
+pyublas::numpy_vector<double> extract(bp::object const& positions);
+
+/// Registers the structure a population was created with.
+void setStructure(boost::shared_ptr<euter::Population> const& population,
+                  boost::shared_ptr<euter::Structure> const& structure);
+
+/// Returns the (cached) positions of all cells of the population.
+boost::shared_ptr<Positions const> get(boost::shared_ptr<euter::Population> const& population);
+
+/// Returns the (cached) spatial index over the positions of the population,
+/// built on first use.
+boost::shared_ptr<KDTree const> index(boost::shared_ptr<euter::Population> const& population);
+
+} // positions
@@ -3,6 +3,7 @@
 #include <algorithm>
 #include <memory>
 #include <iterator>
+#include <unordered_map>
 
 #include <boost/make_shared.hpp>
 
@@ -11,11 +12,50 @@
 #include "py_id.h"
 #include "py_population.h"
 #include "euter/assembly.h"
+#include "euter/population_view.h"
 #include "euter/exceptions.h"
 #include "pyhmf/boost_python.h"
 
 using namespace euter;
 
+/// Positions of the views of an assembly indexed by their label, the first
+/// view with a given label is kept. The assembly may be shared by several
+/// wrappers, thus only views appended since the last lookup are indexed.
+class AssemblyLabels
+{
+public:
+	AssemblyLabels() :
+		mIndexed(0)
+	{}
+
+	PopulationView const* find(Assembly const& assembly, std::string const& label)
+	{
+		auto const& views = assembly.populations();
+		update(views);
+		auto it = mViews.find(label);
+		return it == mViews.end() ? nullptr : &*std::next(views.begin(), it->second);
+	}
+
+private:
+	template <typename Views>
+	void update(Views const& views)
+	{
+		size_t const count = views.size();
+		if (count < mIndexed) {
+			mViews.clear();
+			mIndexed = 0;
+		}
+		auto view = std::next(views.begin(), mIndexed);
+		for (size_t ii = mIndexed; ii < count; ++ii, ++view) {
+			mViews.insert(std::make_pair(view->label(), ii));
+		}
+		mIndexed = count;
+	}
+
+	std::unordered_map<std::string, size_t> mViews;
+	size_t mIndexed;
+};
+
 Assembly & PyAssembly::_get()
 {
 	return *_impl;
@@ -88,12 +128,14 @@ PyAssembly* PyAssembly::_raw_constructor(bp::tuple args, bp::dict kwargs)
 }
 
 PyAssembly::PyAssembly(const boost::shared_ptr<Assembly> & p) :
-    _impl(p)
+    _impl(p),
+    mLabels(boost::make_shared<AssemblyLabels>())
 {
 }
 
 PyAssembly::PyAssembly(const PyPopulationBase & p, std::string label) :
-    _impl(boost::make_shared<Assembly>(*(p._impl), label))
+    _impl(boost::make_shared<Assembly>(*(p._impl), label)),
+    mLabels(boost::make_shared<AssemblyLabels>())
 {
 }
 
@@ -106,6 +148,7 @@ PyAssembly::PyAssembly(const std::vector<PyPopulationView> & populationViews,
 		views.push_back(*(p._impl));
 	}
 	_impl.reset(new Assembly(views, label));
+	mLabels = boost::make_shared<AssemblyLabels>();
 }
 
 /// An PyAssembly may be added to a PyPopulation, PyPopulationView or PyAssembly
@@ -270,7 +313,13 @@ CellIterator<PyAssembly> PyAssembly::end()
 /// the given label. If no such PyPopulation exists, raise KeyError.
 bp::object PyAssembly::get_population(std::string label) const
 {
-	NOT_IMPLEMENTED();
+	PopulationView const* view = mLabels->find(*_impl, label);
+	if (!view) {
+		PyErr_SetString(PyExc_KeyError,
+		                ("Assembly does not contain a population with the label " + label).c_str());
+		bp::throw_error_already_set();
+	}
+	return bp::object(PyPopulationView(boost::make_shared<PopulationView>(*view)));
 }
 
 bool PyAssembly::operator==(const PyAssembly& right) const
@@ -7,6 +7,7 @@
 template<typename ParentType>
 class CellIterator;
 class PyPopulationBase;
+class AssemblyLabels;
 
 namespace euter {
 class Assembly;
@@ -62,6 +63,8 @@ public:
 
 	/// Return the PyPopulation/PyPopulationView from within the PyAssembly that has
 	/// the given label. If no such PyPopulation exists, raise KeyError.
+	/// Labels are indexed on lookup, including views appended via another
+	/// wrapper of the same assembly.
 	bp::object get_population(std::string label) const;
 
 	euter::Assembly & _get();
@@ -73,6 +76,9 @@ public:
 
 	PyAssembly(const boost::shared_ptr<euter::Assembly> & p);
 private:
+	// shared between copies, like _impl
+	boost::shared_ptr<AssemblyLabels> mLabels;
+
 	virtual void apply(std::function<void(euter::PopulationView &)> f);
 	virtual void apply(std::function<void(euter::PopulationView const&)> f) const;
 
@@ -1,11 +1,19 @@
 #include "py_assembly_base.h"
 #include "py_id.h"
+#include "recording.h"
+#include "errors.h"
+#include "positions.h"
 
 #include "pyhmf/boost_python.h"
-#include "pycellparameters/pyparameteraccess.h"
 
 #include "euter/exceptions.h"
 #include "euter/population_view.h"
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <sstream>
+#include <boost/filesystem/fstream.hpp>
 #include <boost/make_shared.hpp>
 #include <boost/numeric/ublas/matrix_proxy.hpp>
 
@@ -23,13 +31,14 @@ PyAssemblyBase::~PyAssemblyBase()
 /// Useful for small populations, for example for single neuron Monte-Carlo.
 bp::object PyAssemblyBase::getSpikes(bool gather, bool compatible_output) const
 {
+	// only cells selected by the view and recorded can have spikes
+	std::vector<boost::dynamic_bitset<> > cells;
 	size_t num_spikes = 0;
-	apply([&num_spikes](PopulationView const& view) {
+	apply([&num_spikes, &cells](PopulationView const& view) {
 		Population const& pop = view.population();
-		for (size_t ii = 0; ii < pop.size(); ++ii) {
-			if (!view.mask()[ii]) {
-				continue;
-			}
+		cells.push_back(view.mask() & recording::recorded(view, recording::SPIKES));
+		auto const& mask = cells.back();
+		for (size_t ii = mask.find_first(); ii != mask.npos; ii = mask.find_next(ii)) {
 			num_spikes += pop.getSpikes(ii).size();
 		}
 	});
@@ -41,13 +50,10 @@ bp::object PyAssemblyBase::getSpikes(bool gather, bool compatible_output) const
 
 	size_t pos = 0;
 	size_t id_offset = 0;
-	apply([&pos, &id_offset, &data](PopulationView const& view) {
+	auto mask = cells.begin();
+	apply([&pos, &id_offset, &data, &mask](PopulationView const& view) {
 		Population const& pop = view.population();
-		for (size_t ii = 0; ii < pop.size(); ++ii) {
-			if (!view.mask()[ii]) {
-				continue;
-			}
-
+		for (size_t ii = mask->find_first(); ii != mask->npos; ii = mask->find_next(ii)) {
 			for (auto const& time : pop.getSpikes(ii)) {
 				// In Populations or PopulationViews, the cell id is the
 				// index within the Population, cf. issue #1955
@@ -61,6 +67,7 @@ bp::object PyAssemblyBase::getSpikes(bool gather, bool compatible_output) const
 			}
 		}
 		id_offset += pop.size(); // add population size to offset
+		++mask;
 	});
 
 	// this should be ok, and doesn't require internal synchronization.
@@ -88,12 +95,12 @@ py_vector_type PyAssemblyBase::get_spike_counts(bool gather)
 		counts.resize(pos+view.size());
 
 		Population const& pop = view.population();
+		auto const& mask = view.mask();
+		auto const recorded = recording::recorded(view, recording::SPIKES);
 		size_t i_c=0;
-		for (size_t ii=0; ii<pop.size(); ++ii) {
-			if (view.mask()[ii]) {
-				counts[pos+i_c] = view.population().getSpikes(ii).size();
-				++i_c;
-			}
+		for (size_t ii = mask.find_first(); ii != mask.npos; ii = mask.find_next(ii)) {
+			counts[pos+i_c] = recorded[ii] ? pop.getSpikes(ii).size() : 0;
+			++i_c;
 		}
 	};
 	apply(std::bind(collect_counts, std::placeholders::_1, std::ref(counts)));
@@ -110,10 +117,8 @@ PyAssemblyBase::get_v(bool gather, bool compatible_output)
 	auto collect_membrane_voltages = [](PopulationView const& view,
 	                                    py_matrix_type& data, size_t& id_offset) {
 		Population const& pop = view.population();
-		for (size_t ii = 0; ii < pop.size(); ii++) {
-			if (!view.mask()[ii])
-				continue;
-
+		auto const mask = view.mask() & recording::recorded(view, recording::V);
+		for (size_t ii = mask.find_first(); ii != mask.npos; ii = mask.find_next(ii)) {
 			size_t pos = data.size1();
 			auto const& voltageTrace = view.population().getMembraneVoltageTrace(ii);
 			// append to data → enlarge and use pos as index offset below
@@ -148,23 +153,193 @@ PyAssemblyBase::get_v(bool gather, bool compatible_output)
 }
 
 
+namespace {
+
+// Translates neuron ids to indices within an assembly. Ids of a population
+// are contiguous starting from firstNeuronId(), thus every view covers a
+// range of ids and the index is its offset in the assembly plus the rank of
+// the cell within the view.
+class IndexTable
+{
+public:
+	IndexTable() : mSize(0), mLast(0) {}
+
+	void add(PopulationView const& view)
+	{
+		// empty views have no ids, skipping them keeps ranges with equal
+		// first ids to views of the same population
+		if (view.size() == 0) {
+			return;
+		}
+		Population const& pop = view.population();
+
+		Range range;
+		range.first_id = pop.firstNeuronId();
+		range.size = pop.size();
+		range.offset = mSize;
+		if (view.size() != pop.size()) {
+			boost::dynamic_bitset<> const& mask = view.mask();
+			range.ranks.assign(pop.size(), -1);
+			long rank = 0;
+			for (size_t ii = mask.find_first(); ii != mask.npos; ii = mask.find_next(ii)) {
+				range.ranks[ii] = rank++;
+			}
+		}
+		mRanges.push_back(std::move(range));
+		mSize += view.size();
+	}
+
+	// Sorts the ranges by id, views of the same population keep the order of
+	// the assembly, such that the first one containing a cell is found.
+	void finalize()
+	{
+		std::stable_sort(mRanges.begin(), mRanges.end(), [](Range const& a, Range const& b) {
+			return a.first_id < b.first_id;
+		});
+	}
+
+	// Returns the index of the cell with the given id, -1 if not contained
+	long operator()(long id)
+	{
+		// ids are usually clustered by population, thus the population of the
+		// previous id is tried first
+		if (!contains(mLast, id)) {
+			auto it = std::upper_bound(
+				mRanges.begin(), mRanges.end(), id,
+				[](long id, Range const& r) { return id < static_cast<long>(r.first_id); });
+			if (it == mRanges.begin()) {
+				return -1;
+			}
+			mLast = it - mRanges.begin() - 1;
+			while (mLast > 0 && mRanges[mLast - 1].first_id == mRanges[mLast].first_id) {
+				--mLast;
+			}
+			if (!contains(mLast, id)) {
+				return -1;
+			}
+		}
+
+		size_t const local = id - mRanges[mLast].first_id;
+		for (size_t ii = mLast;
+		     ii < mRanges.size() && mRanges[ii].first_id == mRanges[mLast].first_id; ++ii) {
+			Range const& range = mRanges[ii];
+			if (range.ranks.empty()) {
+				return range.offset + local;
+			} else if (range.ranks[local] >= 0) {
+				return range.offset + range.ranks[local];
+			}
+		}
+		return -1;
+	}
+
+private:
+	struct Range
+	{
+		size_t first_id;
+		size_t size;
+		size_t offset;
+		// rank of each cell of the population within the view, -1 if not
+		// contained, empty for views of the whole population
+		std::vector<long> ranks;
+	};
+
+	// whether id belongs to the population of range ii
+	bool contains(size_t ii, long id) const
+	{
+		return ii < mRanges.size() && id >= static_cast<long>(mRanges[ii].first_id) &&
+		       static_cast<size_t>(id) - mRanges[ii].first_id < mRanges[ii].size;
+	}
+
+	std::vector<Range> mRanges;
+	size_t mSize;
+	size_t mLast;
+};
+
+void throwNotContained(long id)
+{
+	std::stringstream msg;
+	msg << "Cell " << id << " not in assembly";
+	throw PyIndexError(msg.str());
+}
+
+} // anonymous namespace
+
 /// Given the ID(s) of cell(s) in the PyPopulation, return its (their) index
 /// (order in the PyPopulation).
 /// >>> assert p.id_to_index(p[5]) == 5
 /// >>> assert p.id_to_index(p.index([1,2,3])) == [1,2,3]
-size_t PyAssemblyBase::id_to_index(PyID id)
+pyublas::numpy_vector<long> PyAssemblyBase::id_to_index(bp::object ids) const
 {
-	NOT_IMPLEMENTED();
+	return id_to_index(extractIndices(ids));
 }
 
-std::vector<size_t> PyAssemblyBase::id_to_index(std::vector<PyID> ids)
+// A single id is resolved without building the table: the first view
+// containing the cell is searched, its index is the number of cells of the
+// view before it.
+size_t PyAssemblyBase::id_to_index(PyID id) const
 {
-	NOT_IMPLEMENTED();
+	long index = -1;
+	size_t offset = 0;
+	apply([&index, &offset, &id](PopulationView const& view) {
+		if (index >= 0) {
+			return;
+		}
+		size_t const first = view.population().firstNeuronId();
+		size_t const local = id.id() - first;
+		boost::dynamic_bitset<> const& mask = view.mask();
+		if (id.id() >= first && local < mask.size() && mask[local]) {
+			if (view.size() == mask.size()) {
+				index = offset + local;
+			} else {
+				size_t rank = 0;
+				for (size_t ii = mask.find_first(); ii < local; ii = mask.find_next(ii)) {
+					++rank;
+				}
+				index = offset + rank;
+			}
+		}
+		offset += view.size();
+	});
+
+	if (index < 0) {
+		throwNotContained(id.id());
+	}
+	return index;
 }
 
-npyarray PyAssemblyBase::id_to_index(npyarray ids)
+std::vector<size_t> PyAssemblyBase::id_to_index(std::vector<PyID> ids) const
 {
-	NOT_IMPLEMENTED();
+	IndexTable table;
+	apply([&table](PopulationView const& view) { table.add(view); });
+	table.finalize();
+
+	std::vector<size_t> result(ids.size());
+	for (size_t ii = 0; ii < ids.size(); ++ii) {
+		long const index = table(ids[ii].id());
+		if (index < 0) {
+			throwNotContained(ids[ii].id());
+		}
+		result[ii] = index;
+	}
+	return result;
+}
+
+pyublas::numpy_vector<long> PyAssemblyBase::id_to_index(pyublas::numpy_vector<long> const& ids) const
+{
+	IndexTable table;
+	apply([&table](PopulationView const& view) { table.add(view); });
+	table.finalize();
+
+	pyublas::numpy_vector<long> result(ids.size());
+	auto out = result.as_ublas().begin();
+	for (long const id : ids.as_ublas()) {
+		long const index = table(id);
+		if (index < 0) {
+			throwNotContained(id);
+		}
+		*out++ = index;
+	}
+	return result;
 }
 
 /// Set initial values of state variables, e.g. the membrane potential.
@@ -287,12 +462,14 @@ void PyAssemblyBase::print_v(path const& file, bool gather, bool compatible_outp
 
 void PyAssemblyBase::set_record(std::string parameter_name, bool value)
 {
-	apply([parameter_name, value](PopulationView & p) {
-			std::vector<ParameterProxy> proxy = getPyParameterVector(p);
-			for(size_t ii = 0; ii < proxy.size(); ++ii)
-			{
-				proxy[ii].set(parameter_name, bp::object(value));
-			}
+	recording::Variable variable;
+	if (!recording::fromParameterName(parameter_name, variable)) {
+		throw std::invalid_argument("Unknown recording parameter: " + parameter_name);
+	}
+
+	// the selection is written to the cell parameters on run()
+	apply([variable, value](PopulationView & p) {
+			recording::record(p, variable, value);
 		});
 }
 
@@ -316,8 +493,96 @@ void PyAssemblyBase::record_v(bool)
 	set_record("record_v", true);
 }
 
+namespace {
+
+// Formatted rows are collected and written in chunks of this size
+size_t const chunk_size = 1 << 16;
+
+// Writes the header of a (rows, columns) float64 array in .npy format 1.0,
+// cf. numpy.lib.format
+void writeNpyHeader(std::ostream& out, size_t rows, size_t columns)
+{
+	uint16_t const one = 1;
+	bool const little_endian = *reinterpret_cast<char const*>(&one) == 1;
+
+	std::ostringstream dict;
+	dict << "{'descr': '" << (little_endian ? '<' : '>') << "f8', "
+	     << "'fortran_order': False, 'shape': (" << rows << ", " << columns << "), }";
+	std::string header = dict.str();
+
+	// magic string, version and header length take 10 bytes, the data has to
+	// start at a multiple of 64 bytes, the header is terminated by a newline
+	header.append((64 - (10 + header.size() + 1) % 64) % 64, ' ');
+	header += '\n';
+
+	char const preamble[10] = {
+		'\x93', 'N', 'U', 'M', 'P', 'Y', '\x01', '\x00',
+		static_cast<char>(header.size() & 0xff), static_cast<char>(header.size() >> 8)};
+	out.write(preamble, sizeof(preamble));
+	out << header;
+}
+
+// Appends value with 17 significant digits, which always reads back exactly
+void appendDouble(std::vector<char>& buffer, double value)
+{
+	char str[32];
+	int const length = std::snprintf(str, sizeof(str), "%.17g", value);
+	buffer.insert(buffer.end(), str, str + length);
+}
+
+} // anonymous namespace
+
 /// Save positions to file. The output format is id x y z
-void PyAssemblyBase::save_positions(path const& file)
+void PyAssemblyBase::save_positions(path const& file, bool binary) const
 {
-	NOT_IMPLEMENTED();
+	boost::filesystem::ofstream out(file, std::ios::binary);
+	if (!out) {
+		throw std::runtime_error("Could not open " + file.string());
+	}
+
+	if (binary) {
+		size_t rows = 0;
+		apply([&rows](PopulationView const& view) {
+			rows += view.size();
+		});
+		writeNpyHeader(out, rows, 4);
+	}
+
+	std::vector<char> buffer;
+	buffer.reserve(chunk_size + 128);
+	apply([&](PopulationView const& view) {
+		auto const cached = positions::get(view.population_ptr());
+		double const* x = cached->x();
+		double const* y = cached->y();
+		double const* z = cached->z();
+		size_t const first = view.population().firstNeuronId();
+
+		auto const& mask = view.mask();
+		for (size_t ii = mask.find_first(); ii != mask.npos; ii = mask.find_next(ii)) {
+			if (binary) {
+				double const row[4] = {static_cast<double>(first + ii), x[ii], y[ii], z[ii]};
+				char const* bytes = reinterpret_cast<char const*>(row);
+				buffer.insert(buffer.end(), bytes, bytes + sizeof(row));
+			} else {
+				char id[24];
+				int const length = std::snprintf(id, sizeof(id), "%zu", first + ii);
+				buffer.insert(buffer.end(), id, id + length);
+				for (double const v : {x[ii], y[ii], z[ii]}) {
+					buffer.push_back('\t');
+					appendDouble(buffer, v);
+				}
+				buffer.push_back('\n');
+			}
+
+			if (buffer.size() >= chunk_size) {
+				out.write(buffer.data(), buffer.size());
+				buffer.clear();
+			}
+		}
+	});
+	out.write(buffer.data(), buffer.size());
+
+	if (!out) {
+		throw std::runtime_error("Could not write " + file.string());
+	}
 }
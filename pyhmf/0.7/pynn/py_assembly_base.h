@@ -63,9 +63,12 @@ public:
 	/// (order in the PyPopulation).
 	/// >>> assert p.id_to_index(p[5]) == 5
 	/// >>> assert p.id_to_index(p.index([1,2,3])) == [1,2,3]
-	size_t id_to_index(PyID id);
-	std::vector<size_t> id_to_index(std::vector<PyID> ids);
-	npyarray id_to_index(npyarray ids);
+	/// Declared first, such that it only catches ids not matching the other
+	/// overloads, e.g. arrays of other integer dtypes.
+	pyublas::numpy_vector<long> id_to_index(bp::object ids) const;
+	size_t id_to_index(PyID id) const;
+	std::vector<size_t> id_to_index(std::vector<PyID> ids) const;
+	pyublas::numpy_vector<long> id_to_index(pyublas::numpy_vector<long> const& ids) const;
 
 	/// Set initial values of state variables, e.g. the membrane potential.
 	/// `value` may either be a numeric value (all neurons set to the same
@@ -138,7 +141,8 @@ public:
 	void record_v(bool = true);
 
 	/// Save positions to file. The output format is id x y z
-	void save_positions(path const& file);
+	/// If binary is true, a (n, 4) float64 array is written in .npy format.
+	void save_positions(path const& file, bool binary = false) const;
 
 protected:
 	virtual void apply(std::function<void(euter::PopulationView &)> f) = 0;
@@ -5,45 +5,139 @@
 #include "py_current.h"
 #include "py_assembly.h"
 #include "py_population_base.h"
+#include "py_random.h"
 
 #include "euter/exceptions.h"
+#include "errors.h"
 
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
 #include <map>
+#include <random>
+#include <sstream>
 #include <boost/make_shared.hpp>
 
 using namespace euter;
 
-ublas::vector<double> extractVector(const bp::object obj)
+namespace {
+
+typedef std::map<PopulationPtr, boost::dynamic_bitset<> > mask_map_type;
+
+boost::dynamic_bitset<>& getMask(mask_map_type& masks, PopulationPtr const& pop)
 {
-	ublas::vector<double> vec;
+	boost::dynamic_bitset<>& mask = masks[pop];
+	if (mask.size() != pop->size()) {
+		mask.resize(pop->size());
+	}
+	return mask;
+}
 
-	bp::extract<bp::list> list(obj);
-	if(list.check())
-	{
-		vec.resize(bp::len(list));
+boost::shared_ptr<Assembly> toAssembly(mask_map_type const& masks)
+{
+	std::vector<PopulationView> views;
+	for (auto const& item : masks) {
+		views.push_back(PopulationView(item.first, item.second));
+	}
+	return boost::make_shared<Assembly>(views);
+}
 
-		for(unsigned i = 0; i < bp::len(list); i++)
-		{
-			vec(i) = bp::extract<double>(list()[i]);
-		}
+// Checks all indices in a single pass before any of them is used
+template <typename Iterator>
+void checkBounds(Iterator begin, Iterator end, size_t size)
+{
+	if (begin == end) {
+		return;
 	}
 
-	bp::extract<pyublas::numpy_vector<double> > npy(obj);
-	if(npy.check())
-	{
-		vec = npy().as_ublas();
+	auto const bounds = std::minmax_element(begin, end);
+	if (*bounds.first < 0 || *bounds.second >= static_cast<long>(size)) {
+		std::stringstream msg;
+		msg << "Index " << (*bounds.first < 0 ? *bounds.first : *bounds.second)
+		    << " not in population of size " << size;
+		throw PyIndexError(msg.str());
+	}
+}
+
+} // anonymous namespace
+
+// Arrays of long are passed through without copying.
+pyublas::numpy_vector<long> extractIndices(bp::object const& obj)
+{
+	bp::object const numpy = bp::import("numpy");
+	bp::object const array = numpy.attr("asarray")(obj);
+	if (bp::len(array.attr("shape")) != 1) {
+		throw PyInvalidDimensionsError("Indices must be one-dimensional");
+	}
+	if (bp::len(array) == 0) {
+		// empty sequences have a float dtype
+		return pyublas::numpy_vector<long>(0);
+	}
+	std::string const kind = bp::extract<std::string>(array.attr("dtype").attr("kind"));
+	if (kind != "i" && kind != "u") {
+		PyErr_SetString(PyExc_TypeError, "Indices must be integers");
+		bp::throw_error_already_set();
+	}
+	return bp::extract<pyublas::numpy_vector<long> >(
+		numpy.attr("ascontiguousarray")(array, "l"));
+}
+
+// Returns obj as contiguous float64 numpy array. Arrays which already have
+// this layout are passed through without copying, lists and arrays of other
+// types are converted by numpy in a single call instead of per element.
+pyublas::numpy_vector<double> extractNumpyVector(const bp::object obj)
+{
+	bp::object const numpy = bp::import("numpy");
+	bp::object const array = numpy.attr("ascontiguousarray")(obj, "float64");
+	if (bp::len(array.attr("shape")) != 1) {
+		throw PyInvalidDimensionsError("Time series must be one-dimensional");
 	}
+	return bp::extract<pyublas::numpy_vector<double> >(array);
+}
 
+// The buffer is copied in bulk, as the euter current sources own their
+// (ublas) storage.
+ublas::vector<double> extractVector(const bp::object obj)
+{
+	pyublas::numpy_vector<double> const npy = extractNumpyVector(obj);
+	ublas::vector<double> vec(npy.size());
+	std::copy(npy.as_ublas().begin(), npy.as_ublas().end(), vec.begin());
 	return vec;
 }
 
-PyCurrentSource::PyCurrentSource(boost::shared_ptr<CurrentSource> impl) : _impl(impl)
+PyCurrentSource::PyCurrentSource(boost::shared_ptr<CurrentSource> impl) :
+	_impl(impl),
+	mTargets(boost::make_shared<std::vector<boost::shared_ptr<Assembly> > >())
 {
 }
 
+void PyCurrentSource::inject(boost::shared_ptr<Assembly> const& target)
+{
+	_impl->inject_into(target);
+	mTargets->push_back(target);
+}
+
+pyublas::numpy_vector<long> PyCurrentSource::cell_list() const
+{
+	std::vector<long> ids;
+	for (auto const& target : *mTargets) {
+		for (auto const& view : *target) {
+			boost::dynamic_bitset<> const& mask = view.mask();
+			size_t const first = view.population_ptr()->firstNeuronId();
+			for (size_t ii = mask.find_first(); ii != mask.npos; ii = mask.find_next(ii)) {
+				ids.push_back(first + ii);
+			}
+		}
+	}
+
+	pyublas::numpy_vector<long> result(ids.size());
+	std::copy(ids.begin(), ids.end(), result.as_ublas().begin());
+	return result;
+}
+
 void PyCurrentSource::inject_into(const PyAssembly& target)
 {
-	_impl->inject_into(target._impl);
+	inject(target._impl);
 }
 
 void PyCurrentSource::inject_into(const PyID& cell)
@@ -55,36 +149,103 @@ void PyCurrentSource::inject_into(const PyID& cell)
 	mask[cell.id() - pop->firstNeuronId()] = true;
 	
 	PopulationView view(pop, mask);
-	boost::shared_ptr<Assembly> assembly = boost::make_shared<Assembly>(view);
-	_impl->inject_into(assembly);
+	inject(boost::make_shared<Assembly>(view));
 }
 
 void PyCurrentSource::inject_into(const bp::list& cells)
 {
-	std::map<PopulationPtr, boost::dynamic_bitset<> > tmp;
+	mask_map_type tmp;
 
 	for(int i=0; i<bp::len(cells); ++i)
 	{
 		PyID id = bp::extract<PyID>(cells[i]);
 		PopulationPtr pop = id.parent()->_impl->population_ptr();
-		if(tmp.find(pop) == tmp.end())
-		{
-			tmp[pop] = boost::dynamic_bitset<>(pop->size());
-			tmp[pop].reset();
+		size_t const index = id.id() - pop->firstNeuronId();
+		if (id.id() < pop->firstNeuronId() || index >= pop->size()) {
+			std::stringstream msg;
+			msg << "Cell " << id.id() << " not in population of size " << pop->size();
+			throw PyIndexError(msg.str());
 		}
-		// TODO: Check if within bounds
-		tmp[pop][id.id() - pop->firstNeuronId()] = true;
+		getMask(tmp, pop).set(index);
 	}
 
-	std::vector<PopulationView> views;
+	inject(toAssembly(tmp));
+}
+
+void PyCurrentSource::inject_into(const PyPopulationBase& population, bp::object indices)
+{
+	PopulationView const& view = *population._impl;
+	pyublas::numpy_vector<long> const array = extractIndices(indices);
+	auto const& idx = array.as_ublas();
+	checkBounds(idx.begin(), idx.end(), view.size());
 
-	for (auto i=tmp.begin(); i!=tmp.end(); ++i) {
-		PopulationView view(i->first, i->second);
-		views.push_back(view);
+	mask_map_type tmp;
+	boost::dynamic_bitset<> const& view_mask = view.mask();
+	boost::dynamic_bitset<>& mask = getMask(tmp, view.population_ptr());
+	if (view_mask.count() == view_mask.size()) {
+		// view of the whole population, indices are population indices
+		for (long ii : idx) {
+			mask.set(ii);
+		}
+	} else {
+		// translate indices within the view to population indices
+		std::vector<size_t> positions;
+		positions.reserve(view.size());
+		for (size_t ii = view_mask.find_first(); ii != view_mask.npos;
+		     ii = view_mask.find_next(ii)) {
+			positions.push_back(ii);
+		}
+		for (long ii : idx) {
+			mask.set(positions[ii]);
+		}
 	}
 
-	boost::shared_ptr<Assembly> assembly = boost::make_shared<Assembly>(views);
-	_impl->inject_into(assembly);
+	inject(toAssembly(tmp));
+}
+
+void PyCurrentSource::inject_into(const PyAssembly& target, bp::object ids)
+{
+	// Neuron ids of a population are contiguous starting from
+	// firstNeuronId(), ids are resolved by a binary search over these ranges.
+	mask_map_type domain;
+	for (auto const& view : target._get()) {
+		getMask(domain, view.population_ptr()) |= view.mask();
+	}
+
+	typedef std::pair<size_t, mask_map_type::const_iterator> range_type;
+	std::vector<range_type> ranges;
+	for (auto it = domain.cbegin(); it != domain.cend(); ++it) {
+		ranges.push_back(range_type(it->first->firstNeuronId(), it));
+	}
+	std::sort(ranges.begin(), ranges.end(),
+	          [](range_type const& a, range_type const& b) { return a.first < b.first; });
+
+	mask_map_type tmp;
+	pyublas::numpy_vector<long> const array = extractIndices(ids);
+	for (long id : array.as_ublas()) {
+		auto range = std::upper_bound(
+		    ranges.begin(), ranges.end(), id,
+		    [](long id, range_type const& r) { return id < static_cast<long>(r.first); });
+
+		bool found = false;
+		if (range != ranges.begin()) {
+			--range;
+			PopulationPtr const& pop = range->second->first;
+			size_t const index = id - range->first;
+			if (index < pop->size() && range->second->second[index]) {
+				getMask(tmp, pop).set(index);
+				found = true;
+			}
+		}
+
+		if (!found) {
+			std::stringstream msg;
+			msg << "Cell " << id << " not in assembly";
+			throw PyIndexError(msg.str());
+		}
+	}
+
+	inject(toAssembly(tmp));
 }
 
 PyDCSource::PyDCSource(double amplitude, double start, double stop) :
@@ -93,8 +254,22 @@ PyDCSource::PyDCSource(double amplitude, double start, double stop) :
 }
 
 
+namespace {
+
+boost::shared_ptr<CurrentSource> createStepCurrentSource(bp::object times, bp::object amplitudes)
+{
+	ublas::vector<double> t = extractVector(times);
+	ublas::vector<double> a = extractVector(amplitudes);
+	if (t.size() != a.size()) {
+		throw PyInvalidDimensionsError("times and amplitudes must have the same length");
+	}
+	return StepCurrentSource::create(getStore(), t, a);
+}
+
+} // anonymous namespace
+
 PyStepCurrentSource::PyStepCurrentSource(bp::object times, bp::object amplitudes) :
-	PyCurrentSource(StepCurrentSource::create(getStore(), extractVector(times), extractVector(amplitudes)))
+	PyCurrentSource(createStepCurrentSource(times, amplitudes))
 {
 }
 
@@ -109,11 +284,88 @@ PyACSource::PyACSource(double amplitude,
 {
 }
 
+namespace {
+
+// Fills out with normal distributed samples using the Box-Muller transform.
+// Raw random numbers are drawn block-wise, such that the transformation loop
+// is free of branches and can be vectorized by the compiler.
+void fillNormal(std::mt19937_64& engine, double mean, double stdev,
+                std::vector<double>& out)
+{
+	static size_t const block = 256; // must be even
+	static double const to_unit = 1. / 9007199254740992.; // 2^-53
+	static double const two_pi = 6.283185307179586;
+
+	std::uint64_t raw[block];
+	double samples[block];
+	for (size_t offset = 0; offset < out.size(); offset += block) {
+		for (size_t ii = 0; ii < block; ++ii) {
+			raw[ii] = engine();
+		}
+		for (size_t ii = 0; ii < block; ii += 2) {
+			// u1 in (0, 1] avoids log(0)
+			double const u1 = static_cast<double>((raw[ii] >> 11) + 1) * to_unit;
+			double const u2 = static_cast<double>(raw[ii + 1] >> 11) * to_unit;
+			double const r = stdev * std::sqrt(-2. * std::log(u1));
+			samples[ii] = mean + r * std::cos(two_pi * u2);
+			samples[ii + 1] = mean + r * std::sin(two_pi * u2);
+		}
+		size_t const count = std::min(block, out.size() - offset);
+		std::copy(samples, samples + count, out.begin() + offset);
+	}
+}
+
+} // anonymous namespace
+
 PyNoisyCurrentSource::PyNoisyCurrentSource(double mean,
 										   double stdev,
 										   double dt,
 										   double start,
-										   double stop/*, rng*/) :
-	PyCurrentSource(NoisyCurrentSource::create(getStore(), mean, stdev, dt, start, stop))
+										   double stop,
+										   bp::object rng) :
+	PyCurrentSource(boost::shared_ptr<CurrentSource>())
+{
+	if (rng.is_none()) {
+		_impl = NoisyCurrentSource::create(getStore(), mean, stdev, dt, start, stop);
+		return;
+	}
+
+	if (dt <= 0.) {
+		dt = getStore().getTimestep();
+	}
+	if (stop <= start) {
+		throw PyInvalidParameterValueError(
+			"Pregenerated noise requires stop to be larger than start");
+	}
+
+	// tolerate rounding noise of the division, e.g. (0.07 - 0.) / 0.01 yields
+	// 7.000000000000001 which must not result in an additional step
+	double const steps = (stop - start) / dt;
+	size_t const n = std::max<size_t>(1, static_cast<size_t>(std::ceil(steps - 1e-9)));
+	auto samples = boost::make_shared<std::vector<double> >(n);
+	std::mt19937_64 engine(drawSeed(rng));
+	fillNormal(engine, mean, stdev, *samples);
+	mTrace = samples;
+
+	// one step per sample, the current is switched off at stop
+	ublas::vector<double> times(n + 1);
+	ublas::vector<double> amplitudes(n + 1);
+	for (size_t ii = 0; ii < n; ++ii) {
+		times(ii) = start + ii * dt;
+	}
+	std::copy(mTrace->begin(), mTrace->end(), amplitudes.begin());
+	times(n) = stop;
+	amplitudes(n) = 0.;
+
+	_impl = StepCurrentSource::create(getStore(), times, amplitudes);
+}
+
+py_vector_type PyNoisyCurrentSource::trace() const
 {
+	if (!mTrace) {
+		return py_vector_type(0);
+	}
+	py_vector_type result(mTrace->size());
+	std::copy(mTrace->begin(), mTrace->end(), result.as_ublas().begin());
+	return result;
 }
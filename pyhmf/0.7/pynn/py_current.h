@@ -1,8 +1,11 @@
 #pragma once
 
+#include <vector>
 #include "pyhmf/boost_python_fwd.h"
+#include "pyublas.h"
 
 namespace euter {
+class Assembly;
 class CurrentSource;
 }
 
@@ -17,8 +20,26 @@ public:
 	void inject_into(const PyAssembly& target);
 	void inject_into(const PyID& cell);
 	void inject_into(const bp::list& cells);
+
+	/// Inject into the cells at the given indices of a Population or
+	/// PopulationView, i.e. into population[indices]. Indices may be given as
+	/// array of any integer dtype or sequence of integers.
+	void inject_into(const PyPopulationBase& population, bp::object indices);
+
+	/// Inject into the cells with the given ids, which must belong to the
+	/// given assembly. Ids are accepted as indices are above.
+	void inject_into(const PyAssembly& target, bp::object ids);
+
+	/// Ids of the cells injected into via this source, in order of injection
+	pyublas::numpy_vector<long> cell_list() const;
 protected:
 	boost::shared_ptr<euter::CurrentSource> _impl;
+
+private:
+	void inject(boost::shared_ptr<euter::Assembly> const& target);
+
+	// shared by copies, like _impl
+	boost::shared_ptr<std::vector<boost::shared_ptr<euter::Assembly> > > mTargets;
 };
 
 class PyDCSource : public PyCurrentSource
@@ -47,10 +68,21 @@ public:
 class PyNoisyCurrentSource : public PyCurrentSource
 {
 public:
+	/// If rng is given, the noise trace is pregenerated at dt resolution (the
+	/// simulation timestep if dt is 0) and injected as step current, which
+	/// requires stop > start.
 	PyNoisyCurrentSource(double mean,
 						 double stdev,
 						 double dt=0.0,
 						 double start=0.0,
-						 double stop=0.0/*, rng*/);
+						 double stop=0.0,
+						 bp::object rng=SentinelKeeper::emptyPyObject);
+
+	/// Returns the pregenerated noise trace (empty if no rng was given).
+	py_vector_type trace() const;
+
+private:
+	// kept for trace() only, the step current source owns its own copy
+	boost::shared_ptr<std::vector<double> const> mTrace;
 };
 
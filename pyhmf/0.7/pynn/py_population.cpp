@@ -8,6 +8,8 @@
 #include "celliterator.h"
 #include "errors.h"
 #include "py_id.h"
+#include "positions.h"
+#include "labels.h"
 #include "euter/space.h"
 #include "euter/exceptions.h"
 #include "euter/population.h"
@@ -39,6 +41,9 @@ boost::shared_ptr<euter::PopulationView> PyPopulation::createPopulation(
 
 	euter::CellType t = resolveCellType(celltype);
 	euter::PopulationPtr p  = euter::Population::create(getStore(), size, t, structure, label);
+	Session::own(p);
+	positions::setStructure(p, structure);
+	labels::add(p, label);
 	auto ret = boost::make_shared<euter::PopulationView>(p);
 
 	if(!ret->population().parameters().supported()) {
@@ -216,6 +221,16 @@ PyPopulation create(bp::object cellclass,
 	return population;
 }
 
+// Return a view of the whole population created with the given label.
+PyPopulationView get_population(std::string const& label)
+{
+	euter::PopulationPtr const population = labels::population(label);
+	if (!population) {
+		PyErr_SetString(PyExc_KeyError, ("No population with the label " + label).c_str());
+		bp::throw_error_already_set();
+	}
+	return PyPopulationView(boost::make_shared<euter::PopulationView>(population));
+}
 
 // Record spikes (to a file)
 void record(PyPopulation source, std::string filename)
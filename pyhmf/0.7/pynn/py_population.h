@@ -66,6 +66,10 @@ PyPopulation create(bp::object cellclass,
                     const ParameterDict & cellparams = ParameterDict(),
                     size_t n = 1);
 
+// Return a view of the whole population created with the given label.
+// Raises KeyError if there is no such population.
+PyPopulationView get_population(std::string const& label);
+
 // Record spikes (to a file)
 void record(PyPopulation source, std::string filename);
 
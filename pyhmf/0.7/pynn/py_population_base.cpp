@@ -1,14 +1,21 @@
 #include <boost/make_shared.hpp>
 #include "py_population_base.h"
 
+#include <cstdint>
+#include <random>
+
 #include "pyhmf/boost_python.h"
 #include "py_id.h"
 #include "errors.h"
 #include "py_population_view.h"
 #include "py_population.h"
+#include "recording.h"
+#include "positions.h"
+#include "kdtree.h"
 #include "euter/exceptions.h"
 #include "euter/population_view.h"
 #include "euter/random.h"
+#include "euter/nativerandomgenerator.h"
 #include "pycellparameters/pyparameteraccess.h"
 
 PyPopulationBase::PyPopulationBase()
@@ -58,6 +65,11 @@ void PyPopulationBase::apply(std::function<void(euter::PopulationView const&)> f
 /// Get the values of a parameter for every local cell in the population.
 std::vector<bp::object> PyPopulationBase::get(std::string parameter_name, bool /* gather */)
 {
+	recording::Variable variable;
+	if (recording::fromParameterName(parameter_name, variable)) {
+		recording::commit(*_impl);
+	}
+
 	std::vector<bp::object> parameters;
 	const std::vector<ParameterProxy> & proxy = getPyParameterVector(*_impl);
 	parameters.resize(proxy.size());
@@ -77,6 +89,13 @@ std::vector<bp::object> PyPopulationBase::get(std::string parameter_name, bool /
 /// p.set({'tau_m':20,'v_rest':-65})
 void PyPopulationBase::set(std::string parameter_name, bp::object val)
 {
+	// recording flags are kept as selection masks, cf. recording.h
+	recording::Variable variable;
+	if (recording::fromParameterName(parameter_name, variable)) {
+		recording::record(*_impl, variable, bp::extract<bool>(val));
+		return;
+	}
+
 	std::vector<ParameterProxy> proxy = getPyParameterVector(*_impl);
 	for(size_t ii = 0; ii < proxy.size(); ++ii)
 	{
@@ -91,27 +110,74 @@ void PyPopulationBase::set(const ParameterDict &parameters)
 		return;
 	}
 
+	// recording flags are kept as selection masks, cf. recording.h
+	// The remaining parameters are sorted out once and then applied to every
+	// cell by reference, without copying names or values per cell. Names are
+	// still looked up per cell, pycellparameters' ParameterProxy offers no
+	// access by a resolved field.
+	std::vector<ParameterDict::value_type const*> cell_parameters;
+	cell_parameters.reserve(parameters.size());
+	for (auto const& item : parameters)
+	{
+		recording::Variable variable;
+		if (recording::fromParameterName(item.first, variable)) {
+			recording::record(*_impl, variable, bp::extract<bool>(item.second));
+		} else {
+			cell_parameters.push_back(&item);
+		}
+	}
+
+	if (cell_parameters.empty())
+	{
+		return;
+	}
+
 	const std::vector<ParameterProxy> & proxy = getPyParameterVector(*_impl);
 	for(size_t ii = 0; ii < proxy.size(); ++ii)
 	{
-		for (auto item : parameters)
+		for (auto const* item : cell_parameters)
 		{
-			proxy[ii].set(item.first, item.second);
+			proxy[ii].set(item->first, item->second);
 		}
 	}
 }
 
+namespace {
+
+// Recording flags are kept as selection masks, cf. recording.h. Assigns
+// value(ii) to cell ii of the view if name is a recording flag.
+template <typename Value>
+bool assignRecording(euter::PopulationView const& view, std::string const& name, Value value)
+{
+	recording::Variable variable;
+	if (!recording::fromParameterName(name, variable)) {
+		return false;
+	}
+	boost::dynamic_bitset<> values(view.size());
+	for (size_t ii = 0; ii < values.size(); ++ii) {
+		values[ii] = value(ii);
+	}
+	recording::assign(view, variable, values);
+	return true;
+}
+
+} // anonymous namespace
+
 /// 'Random' set. Set the value of parametername to a value taken from
 /// rand_distr, which should be a RandomDistribution object.
 void PyPopulationBase::rset(std::string parameter_name, PyRandomDistribution rand_distr)
 {
 	auto dist = rand_distr._getDist();
 
-	const std::vector<ParameterProxy> & proxy = getPyParameterVector(*_impl);
 	if(dist->type() == euter::RandomDistribution::INT)
 	{
-		std::vector<euter::distribution_int_t> values(proxy.size());
+		std::vector<euter::distribution_int_t> values(size());
 		dist->next(values);
+		if (assignRecording(*_impl, parameter_name,
+		                    [&values](size_t ii) { return values[ii] != 0; })) {
+			return;
+		}
+		const std::vector<ParameterProxy> & proxy = getPyParameterVector(*_impl);
 		for(size_t ii = 0; ii < proxy.size(); ++ii)
 		{
 		proxy[ii].set(parameter_name, bp::object(values[ii]));
@@ -119,8 +185,13 @@ void PyPopulationBase::rset(std::string parameter_name, PyRandomDistribution ran
 	}
 	else if (dist->type() == euter::RandomDistribution::REAL)
 	{
-		std::vector<euter::distribution_float_t> values(proxy.size());
-		dist->next(values);
+		std::vector<euter::distribution_float_t> values(size());
+		rand_distr._next(values);
+		if (assignRecording(*_impl, parameter_name,
+		                    [&values](size_t ii) { return values[ii] != 0.; })) {
+			return;
+		}
+		const std::vector<ParameterProxy> & proxy = getPyParameterVector(*_impl);
 		for(size_t ii = 0; ii < proxy.size(); ++ii)
 		{
 		proxy[ii].set(parameter_name, bp::object(values[ii]));
@@ -199,18 +270,223 @@ bool PyPopulationBase::is_local(PyID id) const
 }
 
 
+/// Return the positions of all cells as read-only (3, n) array.
+bp::object PyPopulationBase::positions() const
+{
+	auto const cached = positions::get(_impl->population_ptr());
+	boost::dynamic_bitset<> const& mask = _impl->mask();
+
+	size_t const n = size();
+	py_vector_type result(3 * n);
+	double* out = n ? &result.as_ublas()[0] : nullptr;
+	for (size_t axis = 0; axis < 3; ++axis) {
+		double const* in = cached->row(axis);
+		if (n == cached->size()) {
+			std::copy(in, in + n, out + axis * n);
+		} else {
+			size_t jj = axis * n;
+			for (size_t ii = mask.find_first(); ii != mask.npos; ii = mask.find_next(ii)) {
+				out[jj++] = in[ii];
+			}
+		}
+	}
+
+	const long shape[2] = {3, static_cast<long>(n)};
+	result.reshape(2, shape);
+
+	bp::object array(result);
+	array.attr("setflags")(false);
+	return array;
+}
+
+namespace {
+
+// Spatial queries run on the index of the whole population, restricted to
+// the cells of the view unless it covers the whole population.
+boost::dynamic_bitset<> const* queryMask(euter::PopulationView const& view)
+{
+	return view.size() == view.population().size() ? nullptr : &view.mask();
+}
+
+// Returns a single position as pointer to its three coordinates
+double const* extractPosition(pyublas::numpy_vector<double>& position)
+{
+	if (position.size() != 3)
+		throw PyInvalidDimensionsError("Position must be given by three coordinates");
+	return &position.as_ublas()[0];
+}
+
+// Returns the index within the view of a cell of the population
+size_t viewIndex(euter::PopulationView const& view, size_t cell)
+{
+	if (!queryMask(view))
+		return cell;
+
+	boost::dynamic_bitset<> const& mask = view.mask();
+	size_t result = 0;
+	for (size_t ii = mask.find_first(); ii < cell; ii = mask.find_next(ii))
+		++result;
+	return result;
+}
+
+PyPopulationView createView(euter::PopulationView const& view, std::vector<size_t> const& cells)
+{
+	boost::dynamic_bitset<> mask(view.population().size());
+	for (size_t cell : cells)
+		mask.set(cell);
+	return PyPopulationView(boost::make_shared<euter::PopulationView>(view.copy_with_mask(mask)));
+}
+
+} // anonymous namespace
+
 /// Return the neuron closest to the specified position.
 PyID PyPopulationBase::nearest(const bp::object & position) const
 {
-	NOT_IMPLEMENTED();
+	pyublas::numpy_vector<double> p = positions::extract(position);
+	std::vector<size_t> const cells = positions::index(_impl->population_ptr())->nearest(
+		extractPosition(p), 1, queryMask(*_impl));
+	if (cells.empty())
+		throw PyIndexError("Population is empty");
+	return (*this)[viewIndex(*_impl, cells.front())];
 }
 
+pyublas::numpy_vector<long> PyPopulationBase::nearest_indices(const bp::object & points, size_t k) const
+{
+	if (k > size())
+		throw PyInvalidParameterValueError("k must not exceed the number of cells");
+
+	pyublas::numpy_vector<double> p = positions::extract(points);
+	size_t const m = p.size() / 3;
+	double const* coord = m ? &p.as_ublas()[0] : nullptr;
+
+	auto const index = positions::index(_impl->population_ptr());
+	boost::dynamic_bitset<> const* mask = queryMask(*_impl);
+
+	// population index -> index within the view
+	std::vector<long> ranks;
+	if (mask) {
+		ranks.resize(mask->size());
+		long jj = 0;
+		for (size_t ii = mask->find_first(); ii != mask->npos; ii = mask->find_next(ii))
+			ranks[ii] = jj++;
+	}
+
+	pyublas::numpy_vector<long> result(m * k);
+	double point[3];
+	for (size_t ii = 0; ii < m; ++ii) {
+		for (size_t axis = 0; axis < 3; ++axis)
+			point[axis] = coord[axis * m + ii];
+
+		std::vector<size_t> const cells = index->nearest(point, k, mask);
+		for (size_t jj = 0; jj < k; ++jj)
+			result[ii * k + jj] = mask ? ranks[cells[jj]] : static_cast<long>(cells[jj]);
+	}
+
+	const long shape[2] = {static_cast<long>(m), static_cast<long>(k)};
+	result.reshape(2, shape);
+	return result;
+}
+
+PyPopulationView PyPopulationBase::nearest_k(const bp::object & position, size_t k) const
+{
+	pyublas::numpy_vector<double> p = positions::extract(position);
+	return createView(*_impl, positions::index(_impl->population_ptr())->nearest(
+		extractPosition(p), k, queryMask(*_impl)));
+}
+
+PyPopulationView PyPopulationBase::within_distance(const bp::object & position, double radius) const
+{
+	pyublas::numpy_vector<double> p = positions::extract(position);
+	return createView(*_impl, positions::index(_impl->population_ptr())->within(
+		extractPosition(p), radius, queryMask(*_impl)));
+}
+
+bp::list PyPopulationBase::all_within_distance(const bp::object & points, double radius) const
+{
+	pyublas::numpy_vector<double> p = positions::extract(points);
+	size_t const m = p.size() / 3;
+	double const* coord = m ? &p.as_ublas()[0] : nullptr;
+
+	auto const index = positions::index(_impl->population_ptr());
+	boost::dynamic_bitset<> const* mask = queryMask(*_impl);
+
+	bp::list result;
+	double point[3];
+	for (size_t ii = 0; ii < m; ++ii) {
+		for (size_t axis = 0; axis < 3; ++axis)
+			point[axis] = coord[axis * m + ii];
+		result.append(createView(*_impl, index->within(point, radius, mask)));
+	}
+	return result;
+}
+
+namespace {
+
+// Selects k of the cells set in cells uniformly at random, using Floyd's
+// algorithm. Only k random numbers are drawn and no permutation of the cells
+// is needed, a bitset serves as the set of selected cells.
+template <typename URNG>
+boost::dynamic_bitset<> sampleMask(boost::dynamic_bitset<> const& cells, size_t k, URNG& urng)
+{
+	size_t const n = cells.count();
+
+	// for dense samples the complement is sampled instead, such that at most
+	// n/2 numbers are drawn
+	bool const complement = k > n / 2;
+	if (complement)
+		k = n - k;
+
+	// selection among the n set cells, mapped to the population below
+	boost::dynamic_bitset<> selected(n);
+	for (size_t jj = n - k; jj < n; ++jj) {
+		std::uniform_int_distribution<size_t> dist(0, jj);
+		size_t const t = dist(urng);
+		if (selected[t])
+			selected.set(jj);
+		else
+			selected.set(t);
+	}
+	if (complement)
+		selected.flip();
+
+	if (n == cells.size())
+		return selected;
+
+	boost::dynamic_bitset<> result(cells.size());
+	size_t jj = 0;
+	for (size_t ii = cells.find_first(); ii != cells.npos; ii = cells.find_next(ii), ++jj) {
+		if (selected[jj])
+			result.set(ii);
+	}
+	return result;
+}
+
+} // anonymous namespace
 
 /// Randomly sample n cells from the PyPopulation, and return a PyPopulationView
 /// object.
-bp::object PyPopulationBase::sample(size_t n, PyRandomDistribution rng)
+PyPopulationView PyPopulationBase::sample(size_t n, bp::object rng) const
 {
-	NOT_IMPLEMENTED();
+	if (n > size())
+		throw PyInvalidParameterValueError("Cannot sample more cells than available");
+
+	boost::shared_ptr<euter::NativeRandomGenerator> native;
+	if (rng.is_none()) {
+		native = boost::dynamic_pointer_cast<euter::NativeRandomGenerator>(
+			PyNativeRNG::defaultRNG._getRNG());
+	} else if (bp::extract<PyAbstractRNG&>(rng).check()) {
+		PyAbstractRNG& abstract = bp::extract<PyAbstractRNG&>(rng);
+		native = boost::dynamic_pointer_cast<euter::NativeRandomGenerator>(abstract._getRNG());
+	}
+
+	boost::dynamic_bitset<> mask;
+	if (native) {
+		mask = sampleMask(_impl->mask(), n, native->raw());
+	} else {
+		std::mt19937_64 urng(drawSeed(rng));
+		mask = sampleMask(_impl->mask(), n, urng);
+	}
+	return PyPopulationView(boost::make_shared<euter::PopulationView>(_impl->copy_with_mask(mask)));
 }
 
 
@@ -258,6 +534,11 @@ void PyPopulationBase::tset(std::string const& parameter_name, npyarray const& v
 	auto flat_value_array = value_array.reshape(bp::make_tuple(value_array_size));
 #endif
 
+	if (assignRecording(*_impl, parameter_name, [&flat_value_array](size_t ii) {
+		    return bool(bp::extract<bool>(flat_value_array[ii]));
+	    }))
+		return;
+
 	std::vector<ParameterProxy> proxy = getPyParameterVector(*_impl);
 	for (size_t ii = 0; ii < proxy.size(); ++ii)
 		proxy[ii].set(parameter_name, flat_value_array[ii]);
@@ -273,6 +554,11 @@ void PyPopulationBase::tset(std::string const& parameter_name, bp::object const&
 		throw PyInvalidDimensionsError(
 		    "Number of elements in the given array must be equal to the population size");
 
+	if (assignRecording(*_impl, parameter_name, [&value_array](size_t ii) {
+		    return bool(bp::extract<bool>(value_array[ii]));
+	    }))
+		return;
+
 	std::vector<ParameterProxy> proxy = getPyParameterVector(*_impl);
 	for (size_t ii = 0; ii < proxy.size(); ++ii)
 		proxy[ii].set(parameter_name, value_array[ii]);
@@ -63,9 +63,28 @@ public:
 	/// Determine whether the cell with the given ID exists on the local MPI node.
 	bool is_local(PyID id) const;
 
+	/// Return the positions of all cells as read-only (3, n) array.
+	/// Positions are generated once per Population and shared by all views.
+	bp::object positions() const;
+
 	/// Return the neuron closest to the specified position.
+	/// Cells at equal distance are resolved in favour of the smaller index.
 	PyID nearest(const bp::object & position) const;
 
+	/// Return the indices of the k neurons closest to each of the points given
+	/// as (3, m) array, as (m, k) array ordered by distance.
+	pyublas::numpy_vector<long> nearest_indices(const bp::object & points, size_t k = 1) const;
+
+	/// Return the k neurons closest to the specified position.
+	PyPopulationView nearest_k(const bp::object & position, size_t k) const;
+
+	/// Return all neurons at most radius away from the specified position.
+	PyPopulationView within_distance(const bp::object & position, double radius) const;
+
+	/// Return the neurons at most radius away from each of the points given as
+	/// (3, m) array, as list of m views.
+	bp::list all_within_distance(const bp::object & points, double radius) const;
+
 	/// Set initial membrane potentials for all the cells in the population to
 	/// random values.
 	void randomInit(PyRandomDistribution rand_distr);
@@ -77,8 +96,8 @@ public:
 
 	/// Randomly sample n cells from the PyPopulation, and return a PyPopulationView
 	/// object.
-	bp::object sample(size_t n, PyRandomDistribution rng /* = None */);
-	// TODO add useful default value
+	/// rng may be a native or a PyNN RNG, the default native RNG is used if None.
+	PyPopulationView sample(size_t n, bp::object rng = SentinelKeeper::emptyPyObject) const;
 
 	/// Set one or more parameters for every cell in the population. param
 	/// can be a dict, in which case val should not be supplied, or a string
@@ -1,9 +1,14 @@
 #include "py_population_view.h"
 
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
 #include <limits>
+#include <stdexcept>
 #include <boost/assign/std/vector.hpp>
 #include <boost/make_shared.hpp>
 
+#include "buffer.h"
 #include "indexiterator.h"
 #include "errors.h"
 #include "py_id.h"
@@ -43,31 +48,121 @@ boost::dynamic_bitset<> createMask(size_t size, bp::list l)
 	return mask;
 }
 
-boost::dynamic_bitset<> createMask(size_t size, pyublas::numpy_vector<long> v)
+namespace {
+
+// Creates a mask from n cell indices. Bounds are checked in a separate pass
+// over the whole buffer, which the compiler vectorizes, such that the second
+// pass only sets bits.
+template <typename T>
+boost::dynamic_bitset<> indicesToMask(size_t size, T const* indices, size_t n)
 {
 	boost::dynamic_bitset<> mask(size);
-	for (auto ii : v.as_ublas()) {
-		if (ii > static_cast<long>(size)) {
-			throw std::runtime_error("Index out of range");
-		}
-		mask.set(ii);
+	if (n == 0) {
+		return mask;
+	}
+
+	T min = indices[0];
+	T max = indices[0];
+	for (size_t ii = 1; ii < n; ++ii) {
+		min = std::min(min, indices[ii]);
+		max = std::max(max, indices[ii]);
+	}
+	if (min < 0 || static_cast<unsigned long long>(max) >= size) {
+		throw std::runtime_error("Index out of range");
+	}
+
+	for (size_t ii = 0; ii < n; ++ii) {
+		mask.set(static_cast<size_t>(indices[ii]));
 	}
 	return mask;
 }
 
-boost::dynamic_bitset<> createMask(size_t size, pyublas::numpy_vector<bool> v)
+// Creates a mask from one byte per cell (numpy bool), packing a whole block
+// of bits at a time
+boost::dynamic_bitset<> boolsToMask(size_t size, std::uint8_t const* values, size_t n)
 {
-	if (v.size() != size) {
+	if (n != size) {
 		throw std::runtime_error("Size of mask does not match size of population");
 	}
 
-	boost::dynamic_bitset<> mask(size);
-	for (size_t ii = 0; ii < size; ++ii) {
-		mask[ii] = v(ii);
+	typedef boost::dynamic_bitset<>::block_type block_type;
+	size_t const bits = boost::dynamic_bitset<>::bits_per_block;
+
+	std::vector<block_type> blocks((size + bits - 1) / bits);
+	for (size_t bb = 0; bb < blocks.size(); ++bb) {
+		std::uint8_t const* in = values + bb * bits;
+		size_t const count = std::min(bits, size - bb * bits);
+		block_type block = 0;
+		for (size_t jj = 0; jj < count; ++jj) {
+			block |= static_cast<block_type>(in[jj] != 0) << jj;
+		}
+		blocks[bb] = block;
 	}
+
+	boost::dynamic_bitset<> mask(size);
+	boost::from_block_range(blocks.begin(), blocks.end(), mask);
 	return mask;
 }
 
+template <typename T>
+boost::dynamic_bitset<> indicesToMask(size_t size, Py_buffer const& view)
+{
+	return indicesToMask(size, static_cast<T const*>(view.buf), view.len / sizeof(T));
+}
+
+} // anonymous namespace
+
+boost::dynamic_bitset<> createMask(size_t size, pyublas::numpy_vector<long> v)
+{
+	return indicesToMask(size, v.size() ? &v.as_ublas()[0] : nullptr, v.size());
+}
+
+boost::dynamic_bitset<> createMask(size_t size, pyublas::numpy_vector<bool> v)
+{
+	static_assert(sizeof(bool) == 1, "numpy bool arrays are read as bytes");
+	return boolsToMask(
+		size, reinterpret_cast<std::uint8_t const*>(v.size() ? &v.as_ublas()[0] : nullptr),
+		v.size());
+}
+
+// Arrays of any integer (indices) or bool (mask) dtype, other sequences are
+// converted by numpy first.
+boost::dynamic_bitset<> createMask(size_t size, bp::object selector)
+{
+	bp::object const array = bp::import("numpy").attr("ascontiguousarray")(selector);
+	Buffer const buffer(array.ptr());
+	Py_buffer const& view = buffer.view();
+
+	// native byte order only, as created by numpy by default
+	char const* format = view.format;
+	if (*format == '@' || *format == '=' || *format == '<') {
+		++format;
+	}
+
+	if (*format == '?') {
+		return boolsToMask(size, static_cast<std::uint8_t const*>(view.buf), view.len);
+	}
+	if (*format == '\0' || format[1] != '\0' || !std::strchr("bBhHiIlLqQ", *format)) {
+		throw std::runtime_error("Selector must contain integer indices or booleans");
+	}
+
+	switch (view.itemsize) {
+		case 1:
+			return (*format == 'b') ? indicesToMask<std::int8_t>(size, view)
+			                        : indicesToMask<std::uint8_t>(size, view);
+		case 2:
+			return (*format == 'h') ? indicesToMask<std::int16_t>(size, view)
+			                        : indicesToMask<std::uint16_t>(size, view);
+		case 4:
+			return (*format == 'i' || *format == 'l') ? indicesToMask<std::int32_t>(size, view)
+			                                          : indicesToMask<std::uint32_t>(size, view);
+		case 8:
+			return (*format == 'l' || *format == 'q') ? indicesToMask<std::int64_t>(size, view)
+			                                          : indicesToMask<std::uint64_t>(size, view);
+	}
+	throw std::runtime_error("Selector must contain integer indices or booleans");
+}
+
 boost::dynamic_bitset<> createMask(size_t size, bp::slice selector)
 {
 	boost::dynamic_bitset<> mask(size);
@@ -103,6 +198,18 @@ boost::shared_ptr<PopulationView> createView(const PyPopulation & p,
 	return view;
 }
 
+PyPopulationView::PyPopulationView(PyPopulation const& parent, bp::object selector)
+    : PyPopulationBase(createView(parent, selector))
+{
+}
+
+PyPopulationView::PyPopulationView(const PyPopulation & parent,
+                                   bp::object selector,
+                                   std::string label) :
+    PyPopulationBase(createView(parent, selector, label))
+{
+}
+
 PyPopulationView::PyPopulationView(PyPopulation const& parent)
     : PyPopulationBase(createView(parent, true))
 {
@@ -253,6 +360,48 @@ PyPopulationView PyPopulationView::operator[](const pyublas::numpy_vector<long>&
 	return PyPopulationView(boost::make_shared<PopulationView>(view));
 }
 
+namespace {
+
+typedef boost::dynamic_bitset<> mask_type;
+
+// Combines the masks of two views of the same population, the result is
+// computed word-wise by dynamic_bitset
+template <typename Op>
+PyPopulationView combine(PopulationView const& a, PopulationView const& b, Op op)
+{
+	if (a.population_ptr() != b.population_ptr()) {
+		throw std::invalid_argument("Views must have the same parent Population");
+	}
+	return PyPopulationView(boost::make_shared<PopulationView>(
+		a.copy_with_mask(op(a.mask(), b.mask()))));
+}
+
+} // anonymous namespace
+
+PyPopulationView PyPopulationView::operator&(const PyPopulationView& other) const
+{
+	return combine(*_impl, *other._impl,
+	               [](mask_type const& a, mask_type const& b) { return a & b; });
+}
+
+PyPopulationView PyPopulationView::operator|(const PyPopulationView& other) const
+{
+	return combine(*_impl, *other._impl,
+	               [](mask_type const& a, mask_type const& b) { return a | b; });
+}
+
+PyPopulationView PyPopulationView::operator-(const PyPopulationView& other) const
+{
+	return combine(*_impl, *other._impl,
+	               [](mask_type const& a, mask_type const& b) { return a - b; });
+}
+
+PyPopulationView PyPopulationView::operator^(const PyPopulationView& other) const
+{
+	return combine(*_impl, *other._impl,
+	               [](mask_type const& a, mask_type const& b) { return a ^ b; });
+}
+
 CellIterator<PyPopulationBase> PyPopulationView::begin()
 {
 	return CellIterator<PyPopulationBase>(0, boost::make_shared<PyPopulationView>(*this));
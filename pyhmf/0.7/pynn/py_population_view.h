@@ -15,6 +15,14 @@ public:
 	/// PyPopulationView(p, array([2,4]))
 	/// PyPopulationView(p, slice(2,5,2))
 	/// will all create the same view.
+	/// Arrays of any integer or bool dtype are read from their buffer.
+	/// Boost.Python tries overloads in reverse order of registration, thus
+	/// declaring these first makes them catch only selectors not matching
+	/// any of the other overloads.
+	PyPopulationView(PyPopulation const& parent, bp::object selector);
+	PyPopulationView(const PyPopulation & parent,
+	                 bp::object selector,
+	                 std::string label);
 	PyPopulationView(PyPopulation const& parent);
 	PyPopulationView(const PyPopulation & parent,
 	                 std::string label);
@@ -47,6 +55,14 @@ public:
 	PyPopulationView operator[](const pyublas::numpy_vector<long>& indices) const;
 	PyPopulationView operator[](const bp::slice& selection) const;
 
+	/// Set operations on views of the same parent PyPopulation, returning the
+	/// cells in both (&), in either (|), only in the first (-) or in exactly
+	/// one (^) of the views, e.g. p[0:6] - p[::2] contains cells 1, 3 and 5.
+	PyPopulationView operator&(const PyPopulationView& other) const;
+	PyPopulationView operator|(const PyPopulationView& other) const;
+	PyPopulationView operator-(const PyPopulationView& other) const;
+	PyPopulationView operator^(const PyPopulationView& other) const;
+
 	CellIterator<PyPopulationBase> begin();
 	CellIterator<PyPopulationBase> end();
 
@@ -9,6 +9,7 @@
 #include "py_random.h"
 #include "pyublas.h"
 #include "errors.h"
+#include "labels.h"
 
 #include "pyhmf/boost_python.h"
 #include "pyhmf/objectstore.h"
@@ -64,12 +65,25 @@ PyProjectionPtr PyProjection::create(
 	try {
 		auto p = boost::make_shared<PyProjection>();
 		p->_impl = Projection::create(getStore(), pre._get(), post._get(), c->_getImpl(), rng._getRNG(), s, t, tmp_synapse_dynamics, l);
+		labels::add(p->_impl, l);
 		return p;
 	} catch(InvalidDimensions const& exc) {
 		throw PyInvalidDimensionsError(exc.what());
 	}
 }
 
+PyProjectionPtr get_projection(std::string const& label)
+{
+	ProjectionPtr const projection = labels::projection(label);
+	if (!projection) {
+		PyErr_SetString(PyExc_KeyError, ("No projection with the label " + label).c_str());
+		bp::throw_error_already_set();
+	}
+	auto p = boost::make_shared<PyProjection>();
+	p->_impl = projection;
+	return p;
+}
+
 PyAssembly PyProjection::getPre() const
 {
 	return PyAssembly(boost::make_shared<Assembly>(_impl->pre()));
@@ -154,4 +154,8 @@ PyProjectionPtr connect(
         const PyAbstractRNG & rng = PyNativeRNG::defaultRNG
 );
 
+// Return the projection created with the given label.
+// Raises KeyError if there is no such projection.
+PyProjectionPtr get_projection(std::string const& label);
+
 std::ostream & operator<<(std::ostream & out, const PyProjectionPtr & p);
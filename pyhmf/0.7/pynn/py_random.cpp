@@ -2,16 +2,26 @@
 #include "pyublas.h"
 
 #include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <numeric>
 #include <type_traits>
 #include <unordered_map>
 #include <boost/make_shared.hpp>
 
 #include "pyhmf/boost_python.h"
+#include "buffer.h"
 #include "euter/exceptions.h"
 #include "euter/nativerandomgenerator.h"
 #include "euter/nativerandomdistributions.h"
 #include "euter/random.h"
 
+#include "philox.h"
+#include "rngs.h"
+#include "transforms.h"
+#include "truncated.h"
+
 #include "ztl/pack/pack.h"
 #include "ztl/pack/get.h"
 
@@ -195,16 +205,70 @@ static std::unique_ptr<NRDProxy> create_NRDProxy(std::string name, const NRDProx
 	NativeRandomDistributionFactory factory = get_NRDProxy_factory(name);
 	return factory(rng, parameters);
 }
+
+// PyNN passes None or False if all values are local
+bool isMasked(bp::object const& mask_local)
+{
+	return !mask_local.is_none() && !PyBool_Check(mask_local.ptr());
+}
+
+// Returns mask_local as contiguous boolean array of size n
+pyublas::numpy_vector<bool> localMask(size_t n, bp::object const& mask_local)
+{
+	pyublas::numpy_vector<bool> const mask = bp::extract<pyublas::numpy_vector<bool> >(
+		bp::import("numpy").attr("ascontiguousarray")(mask_local, "bool"));
+	if (mask.size() != n) {
+		throw std::invalid_argument("Size of mask_local does not match n");
+	}
+	return mask;
+}
+
+// Returns the local values of the array of all n values drawn by RNGs that
+// can't skip values.
+bp::object selectLocal(bp::object const& values, size_t n, bp::object const& mask_local)
+{
+	return values[bp::object(localMask(n, mask_local))];
+}
+
+// Seed for a child of an RNG, drawn from its native generator
+random_int_t spawnSeed(NativeRandomGenerator& rng)
+{
+	std::uniform_int_distribution<random_int_t> d;
+	return d(rng.raw());
+}
+
+bp::object toBytes(std::string const& data)
+{
+	return bp::object(bp::handle<>(PyBytes_FromStringAndSize(data.data(), data.size())));
+}
+
+std::string fromBytes(bp::object const& state)
+{
+	Buffer const buffer(state.ptr(), PyBUF_SIMPLE);
+	return std::string(static_cast<char const*>(buffer.view().buf), buffer.view().len);
+}
+
+std::string nativeState(NativeRandomGenerator& rng)
+{
+	rngs::StateWriter writer('N');
+	writer.engine(rng.raw());
+	return writer.data();
+}
 }
 
 PyNativeRNG::PyNativeRNG() :
 	_impl(boost::make_shared<NativeRandomGenerator>())
 {
+	NativeRandomGenerator* const rng = _impl.get();
+	rngs::add(_impl, "NativeRNG()", [rng]() { return nativeState(*rng); });
 }
 
 PyNativeRNG::PyNativeRNG(size_t seed) :
 	_impl(boost::make_shared<NativeRandomGenerator>(seed))
 {
+	NativeRandomGenerator* const rng = _impl.get();
+	rngs::add(_impl, "NativeRNG(seed=" + std::to_string(seed) + ")",
+	          [rng]() { return nativeState(*rng); });
 }
 
 boost::shared_ptr<RandomGenerator> PyNativeRNG::_getRNG() const
@@ -224,10 +288,14 @@ PyNativeRNG::_getRandomDistribution(
 bp::object PyNativeRNG::next(size_t n,
 				std::string distribution,
 				bp::list parameters,
-				size_t /* mask_local */)
+				bp::object mask_local)
 {
 	std::unique_ptr<NRDProxy> dist(create_NRDProxy(distribution, _impl, parameters));
-	if (n == 1)
+	if (isMasked(mask_local))
+	{
+		return selectLocal(dist->operator()(n), n, mask_local);
+	}
+	else if (n == 1)
 	{
 		return *dist->operator()();
 	}
@@ -237,6 +305,29 @@ bp::object PyNativeRNG::next(size_t n,
 	}
 }
 
+bp::list PyNativeRNG::spawn(size_t k)
+{
+	bp::list children;
+	for (size_t ii = 0; ii < k; ++ii) {
+		children.append(PyNativeRNG(spawnSeed(*_impl)));
+	}
+	return children;
+}
+
+bp::object PyNativeRNG::get_state() const
+{
+	return toBytes(nativeState(*_impl));
+}
+
+void PyNativeRNG::set_state(bp::object state)
+{
+	rngs::StateReader reader(fromBytes(state), 'N');
+	auto engine = _impl->raw();
+	reader.engine(engine);
+	reader.finish();
+	_impl->raw() = engine;
+}
+
 bp::list PyNativeRNG::permutation(bp::list const& lin)
 {
     std::vector<bp::object> v;
@@ -253,6 +344,85 @@ bp::list PyNativeRNG::permutation(bp::list const& lin)
     return lout;
 }
 
+namespace {
+
+// Fisher-Yates shuffle of n items of type T, drawing and swapping in a single
+// pass. The engine is shared with python, thus the GIL is held throughout.
+template <typename T, typename Engine>
+void shuffleItems(Engine& engine, T* data, size_t n)
+{
+	for (size_t ii = n; ii > 1; --ii) {
+		size_t const jj = std::uniform_int_distribution<size_t>(0, ii - 1)(engine);
+		std::swap(data[ii - 1], data[jj]);
+	}
+}
+
+// Fisher-Yates shuffle of n rows of the given size in bytes, drawing the same
+// numbers as shuffleItems
+template <typename Engine>
+void shuffleRows(Engine& engine, char* data, size_t n, size_t size)
+{
+	std::vector<char> tmp(size);
+	for (size_t ii = n; ii > 1; --ii) {
+		size_t const jj = std::uniform_int_distribution<size_t>(0, ii - 1)(engine);
+		if (jj != ii - 1) {
+			char* const a = data + (ii - 1) * size;
+			char* const b = data + jj * size;
+			std::memcpy(tmp.data(), a, size);
+			std::memcpy(a, b, size);
+			std::memcpy(b, tmp.data(), size);
+		}
+	}
+}
+
+template <typename T>
+bool isAligned(void const* ptr)
+{
+	return reinterpret_cast<std::uintptr_t>(ptr) % alignof(T) == 0;
+}
+
+} // anonymous namespace
+
+pyublas::numpy_vector<long> PyNativeRNG::permutation(size_t n)
+{
+	pyublas::numpy_vector<long> result(n);
+	if (n > 0) {
+		long* const data = &result.as_ublas()[0];
+		std::iota(data, data + n, 0l);
+		shuffleItems(_impl->raw(), data, n);
+	}
+	return result;
+}
+
+void PyNativeRNG::shuffle(bp::object array)
+{
+	Buffer const buffer(array.ptr(), PyBUF_WRITABLE | PyBUF_C_CONTIGUOUS);
+	Py_buffer const& view = buffer.view();
+	if (view.ndim == 0) {
+		throw std::invalid_argument("Can't shuffle a 0-d array");
+	}
+
+	size_t const n = view.shape[0];
+	if (n < 2) {
+		return;
+	}
+	size_t const size = view.len / n;
+	void* const data = view.buf;
+
+	auto& engine = _impl->raw();
+	if (size == 8 && isAligned<std::uint64_t>(data)) {
+		shuffleItems(engine, static_cast<std::uint64_t*>(data), n);
+	} else if (size == 4 && isAligned<std::uint32_t>(data)) {
+		shuffleItems(engine, static_cast<std::uint32_t*>(data), n);
+	} else if (size == 2 && isAligned<std::uint16_t>(data)) {
+		shuffleItems(engine, static_cast<std::uint16_t*>(data), n);
+	} else if (size == 1) {
+		shuffleItems(engine, static_cast<std::uint8_t*>(data), n);
+	} else {
+		shuffleRows(engine, static_cast<char*>(data), n, size);
+	}
+}
+
 distribution_int_t PyNativeRNG::randint(distribution_int_t a, distribution_int_t b)
 {
 	std::uniform_int_distribution<distribution_int_t> d(a, b);
@@ -295,24 +465,767 @@ distribution_float_t PyNativeRNG::exponential(distribution_float_t lambda)
 	return d(_impl->raw());
 }
 
+namespace {
+
+template <typename T>
+T parameter(bp::list const& parameters, size_t pos, T value)
+{
+	if (pos < static_cast<size_t>(bp::len(parameters))) {
+		value = bp::extract<T>(parameters[pos]);
+	}
+	return value;
+}
+
+void checkParameters(bp::list const& parameters, size_t min, size_t max)
+{
+	size_t const count = bp::len(parameters);
+	if (count < min || count > max) {
+		throw std::invalid_argument("Invalid number of parameters");
+	}
+}
+
+// Fills values [first, first + n) of a stream
+struct FillRange
+{
+	template <typename Distribution>
+	void operator()(Distribution const& d, size_t n,
+	                typename Distribution::result_type* out) const
+	{
+		stream.fill(d, first, n, out);
+	}
+
+	philox::Stream stream;
+	std::uint64_t first;
+};
+
+// Fills the values at the given positions of a stream
+struct FillGather
+{
+	template <typename Distribution>
+	void operator()(Distribution const& d, size_t n,
+	                typename Distribution::result_type* out) const
+	{
+		stream.gather(d, positions, n, out);
+	}
+
+	philox::Stream stream;
+	std::uint64_t const* positions;
+};
+
+template <typename Distribution, typename Fill>
+bp::object drawWith(Distribution const& d, size_t n, bool scalar, Fill const& fill)
+{
+	typedef typename Distribution::result_type result_type;
+	if (scalar) {
+		result_type value;
+		fill(d, 1, &value);
+		return bp::object(value);
+	}
+
+	pyublas::numpy_vector<result_type> values(n);
+	if (n > 0) {
+		fill(d, n, &values.as_ublas()[0]);
+	}
+	return bp::object(values);
+}
+
+// Draws n values of the named distribution, a single one is returned as scalar
+// if requested.
+template <typename Fill>
+bp::object draw(std::string const& distribution, bp::list const& parameters, size_t n,
+                bool scalar, Fill const& fill)
+{
+	if (distribution == "uniform") {
+		checkParameters(parameters, 0, 2);
+		transforms::Uniform const d(parameter(parameters, 0, 0.), parameter(parameters, 1, 1.));
+		return drawWith(d, n, scalar, fill);
+	} else if (distribution == "normal") {
+		checkParameters(parameters, 0, 2);
+		transforms::Normal const d(parameter(parameters, 0, 0.), parameter(parameters, 1, 1.));
+		return drawWith(d, n, scalar, fill);
+	} else if (distribution == "exponential") {
+		checkParameters(parameters, 0, 1);
+		transforms::Exponential const d(parameter(parameters, 0, 1.));
+		return drawWith(d, n, scalar, fill);
+	} else if (distribution == "randint") {
+		checkParameters(parameters, 2, 2);
+		transforms::Integer const d(parameter<std::int64_t>(parameters, 0, 0),
+		                        parameter<std::int64_t>(parameters, 1, 0));
+		return drawWith(d, n, scalar, fill);
+	}
+	throw std::invalid_argument("Unkown distribution");
+}
+
+} // anonymous namespace
+
+std::string PyCounterRNG::dump(State const& state, NativeRandomGenerator& native)
+{
+	rngs::StateWriter writer('C');
+	writer.integer(state.seed);
+	writer.integer(state.stream);
+	writer.integer(state.position);
+	writer.integer(state.spawned);
+	writer.engine(native.raw());
+	return writer.data();
+}
+
+PyCounterRNG::PyCounterRNG(std::uint64_t seed, std::uint64_t stream) :
+	mState(boost::make_shared<State>()),
+	// the last position of the stream is reserved for seeding the native RNG
+	mNative(boost::make_shared<NativeRandomGenerator>(static_cast<random_int_t>(
+		philox::Stream(seed, stream).raw(std::numeric_limits<std::uint64_t>::max()))))
+{
+	mState->seed = seed;
+	mState->stream = stream;
+	mState->position = 0;
+	mState->spawned = 0;
+
+	State const* const s = mState.get();
+	NativeRandomGenerator* const native = mNative.get();
+	rngs::add(mState,
+	          "CounterRNG(seed=" + std::to_string(seed) + ", stream=" + std::to_string(stream) + ")",
+	          [s, native]() { return dump(*s, *native); });
+}
+
+bp::object PyCounterRNG::next(size_t n,
+				std::string distribution,
+				bp::list parameters,
+				bp::object mask_local)
+{
+	philox::Stream const stream(mState->seed, mState->stream);
+	bp::object result;
+	if (isMasked(mask_local)) {
+		// values of other processes are skipped without generating them
+		pyublas::numpy_vector<bool> const mask = localMask(n, mask_local);
+		std::vector<std::uint64_t> positions;
+		for (size_t ii = 0; ii < n; ++ii) {
+			if (mask[ii]) {
+				positions.push_back(mState->position + ii);
+			}
+		}
+		FillGather const fill = {stream, positions.data()};
+		result = draw(distribution, parameters, positions.size(), false, fill);
+	} else {
+		FillRange const fill = {stream, mState->position};
+		result = draw(distribution, parameters, n, n == 1, fill);
+	}
+	mState->position += n;
+	return result;
+}
+
+bp::list PyCounterRNG::spawn(size_t k)
+{
+	// the last position is used for seeding the native RNG
+	philox::Stream const stream(mState->seed, mState->stream);
+	bp::list children;
+	for (size_t ii = 0; ii < k; ++ii, ++mState->spawned) {
+		std::uint64_t const position = std::numeric_limits<std::uint64_t>::max() - 1 - mState->spawned;
+		children.append(PyCounterRNG(mState->seed, stream.raw(position)));
+	}
+	return children;
+}
+
+bp::object PyCounterRNG::at(pyublas::numpy_vector<long> const& positions,
+				std::string distribution,
+				bp::list parameters) const
+{
+	std::vector<std::uint64_t> indices(positions.size());
+	for (size_t ii = 0; ii < indices.size(); ++ii) {
+		if (positions[ii] < 0) {
+			throw std::invalid_argument("Stream positions must not be negative");
+		}
+		indices[ii] = positions[ii];
+	}
+
+	FillGather const fill = {philox::Stream(mState->seed, mState->stream), indices.data()};
+	return draw(distribution, parameters, indices.size(), false, fill);
+}
+
+std::uint64_t PyCounterRNG::seed() const
+{
+	return mState->seed;
+}
+
+std::uint64_t PyCounterRNG::stream() const
+{
+	return mState->stream;
+}
+
+std::uint64_t PyCounterRNG::position() const
+{
+	return mState->position;
+}
+
+void PyCounterRNG::seek(std::uint64_t position)
+{
+	mState->position = position;
+}
+
+bp::object PyCounterRNG::get_state() const
+{
+	return toBytes(dump(*mState, *mNative));
+}
+
+void PyCounterRNG::set_state(bp::object state)
+{
+	rngs::StateReader reader(fromBytes(state), 'C');
+	State s;
+	s.seed = reader.integer();
+	s.stream = reader.integer();
+	s.position = reader.integer();
+	s.spawned = reader.integer();
+	auto engine = mNative->raw();
+	reader.engine(engine);
+	reader.finish();
+
+	*mState = s;
+	mNative->raw() = engine;
+}
+
+boost::shared_ptr<RandomGenerator> PyCounterRNG::_getRNG() const
+{
+	return mNative;
+}
+
+boost::shared_ptr<RandomDistribution>
+PyCounterRNG::_getRandomDistribution(
+        std::string distribution,
+        bp::list parameters) const
+{
+	auto proxy = create_NRDProxy(distribution, mNative, parameters);
+	return proxy->get_distribution();
+}
+
+// Layout of numpy's bitgen_t (numpy/random/bitgen.h), exported by the capsule
+// of every numpy.random.BitGenerator.
+struct PyNumpyRNG::BitGenerator
+{
+	void* state;
+	std::uint64_t (*next_uint64)(void* state);
+	std::uint32_t (*next_uint32)(void* state);
+	double (*next_double)(void* state);
+	std::uint64_t (*next_raw)(void* state);
+};
+
+namespace {
+
+// Fills values from a numpy bit generator, two 64 bit words per pair of values.
+// Uniform values are drawn as by numpy itself.
+struct FillBitGenerator
+{
+	template <typename Distribution>
+	void operator()(Distribution const& d, size_t n,
+	                typename Distribution::result_type* out) const
+	{
+		size_t ii = 0;
+		for (; ii + 1 < n; ii += 2) {
+			std::uint64_t const a = next_uint64(state);
+			d(a, next_uint64(state), out + ii);
+		}
+		if (ii < n) {
+			typename Distribution::result_type pair[2];
+			std::uint64_t const a = next_uint64(state);
+			d(a, next_uint64(state), pair);
+			out[ii] = pair[0];
+		}
+	}
+
+	void operator()(transforms::Uniform const& d, size_t n, double* out) const
+	{
+		for (size_t ii = 0; ii < n; ++ii) {
+			out[ii] = d.low + (d.high - d.low) * next_double(state);
+		}
+	}
+
+	void* state;
+	std::uint64_t (*next_uint64)(void*);
+	double (*next_double)(void*);
+};
+
+// Holds the lock of a numpy bit generator, as numpy does while drawing. Python
+// releases the GIL while waiting for the lock.
+class LockBitGenerator
+{
+public:
+	explicit LockBitGenerator(bp::object const& lock) :
+		mLock(lock)
+	{
+		mLock.attr("acquire")();
+	}
+
+	~LockBitGenerator()
+	{
+		mLock.attr("release")();
+	}
+
+private:
+	LockBitGenerator(LockBitGenerator const&);
+	LockBitGenerator& operator=(LockBitGenerator const&);
+
+	bp::object mLock;
+};
+
+} // anonymous namespace
+
+namespace {
+
+// Python int >= 0 as count and 32 bit words, least significant first
+void writeInt(rngs::StateWriter& writer, bp::object value)
+{
+	std::vector<std::uint64_t> words;
+	bp::object const zero(0);
+	while (value != zero) {
+		words.push_back(bp::extract<std::uint64_t>(value & 0xffffffff));
+		value = value >> 32;
+	}
+	writer.integer(words.size());
+	for (std::uint64_t word : words) {
+		writer.integer(word);
+	}
+}
+
+bp::object readInt(rngs::StateReader& reader)
+{
+	std::vector<std::uint64_t> words(reader.integer());
+	for (std::uint64_t& word : words) {
+		word = reader.integer();
+	}
+	bp::object value(0);
+	for (auto it = words.rbegin(); it != words.rend(); ++it) {
+		value = (value << 32) | bp::object(*it);
+	}
+	return value;
+}
+
+// Child ii of a numpy SeedSequence, as returned by its spawn()
+bp::object spawnSequence(bp::object const& sequence, size_t ii)
+{
+	bp::dict kwargs;
+	kwargs["spawn_key"] = sequence.attr("spawn_key") + bp::make_tuple(ii);
+	kwargs["pool_size"] = sequence.attr("pool_size");
+	return bp::import("numpy.random").attr("SeedSequence")(
+		*bp::make_tuple(sequence.attr("entropy")), **kwargs);
+}
+
+std::string toString(bp::object const& value)
+{
+	return bp::extract<std::string>(bp::str(value));
+}
+
+// First 32 bit word generated by a numpy SeedSequence
+random_int_t nativeSeed(bp::object const& sequence)
+{
+	return bp::extract<random_int_t>(sequence.attr("generate_state")(1)[0].attr("item")());
+}
+
+// MT19937 in the state numpy.random.RandomState(seed) starts with
+bp::object legacyMT19937(random_int_t seed)
+{
+	bp::object const random = bp::import("numpy.random");
+	bp::object const bit_generator = random.attr("MT19937")();
+	bp::dict kwargs;
+	kwargs["legacy"] = false;
+	bit_generator.attr("state") =
+		random.attr("RandomState")(seed).attr("get_state")(*bp::tuple(), **kwargs);
+	return bit_generator;
+}
+
+} // anonymous namespace
+
+std::string PyNumpyRNG::dump(State const& state, NativeRandomGenerator& native)
+{
+	bp::object mt;
+	{
+		LockBitGenerator const lock(state.lock);
+		mt = state.bitGenerator.attr("state")["state"];
+	}
+	bp::object const key = mt["key"];
+	Buffer const buffer(key.ptr());
+	Py_buffer const& view = buffer.view();
+	if (view.itemsize != sizeof(std::uint32_t)) {
+		throw std::runtime_error("Unexpected MT19937 key");
+	}
+	std::uint32_t const* const words = static_cast<std::uint32_t const*>(view.buf);
+
+	rngs::StateWriter writer('M');
+	writeInt(writer, state.seedSequence.attr("entropy"));
+	bp::object const spawn_key = state.seedSequence.attr("spawn_key");
+	writer.integer(bp::len(spawn_key));
+	for (bp::ssize_t ii = 0; ii < bp::len(spawn_key); ++ii) {
+		writer.integer(bp::extract<std::uint64_t>(spawn_key[ii]));
+	}
+	writer.integer(bp::extract<std::uint64_t>(state.seedSequence.attr("pool_size")));
+	writer.integer(view.len / view.itemsize);
+	for (Py_ssize_t ii = 0; ii < view.len / view.itemsize; ++ii) {
+		writer.integer(words[ii]);
+	}
+	writer.integer(bp::extract<std::uint64_t>(mt["pos"]));
+	writer.integer(state.spawned);
+	writer.engine(native.raw());
+	return writer.data();
+}
+
 PyNumpyRNG::PyNumpyRNG()
 {
-    NOT_IMPLEMENTED();
+	// the native RNG is seeded from the same entropy as the bit generator
+	bp::object const sequence = bp::import("numpy.random").attr("SeedSequence")();
+	mNative = boost::make_shared<NativeRandomGenerator>(nativeSeed(sequence));
+	init(sequence, bp::import("numpy.random").attr("MT19937")(sequence));
+}
+
+PyNumpyRNG::PyNumpyRNG(random_int_t seed) :
+	mNative(boost::make_shared<NativeRandomGenerator>(seed))
+{
+	init(bp::import("numpy.random").attr("SeedSequence")(seed), legacyMT19937(seed));
+}
+
+PyNumpyRNG::PyNumpyRNG(bp::object seed_sequence, random_int_t seed) :
+	mNative(boost::make_shared<NativeRandomGenerator>(seed))
+{
+	init(seed_sequence, bp::import("numpy.random").attr("MT19937")(seed_sequence));
+}
+
+void PyNumpyRNG::init(bp::object seed_sequence, bp::object bit_generator)
+{
+	bp::object const capsule = bit_generator.attr("capsule");
+	void* const ptr = PyCapsule_GetPointer(capsule.ptr(), "BitGenerator");
+	if (!ptr) {
+		bp::throw_error_already_set();
+	}
+	mState = boost::make_shared<State>();
+	mState->seedSequence = seed_sequence;
+	mState->bitGenerator = bit_generator;
+	mState->lock = bit_generator.attr("lock");
+	mState->spawned = 0;
+	mBitGen = static_cast<BitGenerator*>(ptr);
+
+	State const* const s = mState.get();
+	NativeRandomGenerator* const native = mNative.get();
+	std::string const identity = "NumpyRNG(entropy=" + toString(seed_sequence.attr("entropy")) +
+	                             ", spawn_key=" + toString(seed_sequence.attr("spawn_key")) + ")";
+	rngs::add(mState, identity, [s, native]() { return dump(*s, *native); });
+}
+
+bp::object PyNumpyRNG::next(size_t n,
+				std::string distribution,
+				bp::list parameters,
+				bp::object mask_local)
+{
+	FillBitGenerator const fill = {mBitGen->state, mBitGen->next_uint64, mBitGen->next_double};
+	LockBitGenerator const lock(mState->lock);
+	if (isMasked(mask_local)) {
+		return selectLocal(draw(distribution, parameters, n, false, fill), n, mask_local);
+	}
+	return draw(distribution, parameters, n, n == 1, fill);
+}
+
+bp::list PyNumpyRNG::spawn(size_t k)
+{
+	bp::list children;
+	for (size_t ii = 0; ii < k; ++ii, ++mState->spawned) {
+		bp::object const sequence = spawnSequence(mState->seedSequence, mState->spawned);
+		children.append(PyNumpyRNG(sequence, spawnSeed(*mNative)));
+	}
+	return children;
+}
+
+bp::object PyNumpyRNG::bit_generator() const
+{
+	return mState->bitGenerator;
+}
+
+bp::object PyNumpyRNG::get_state() const
+{
+	return toBytes(dump(*mState, *mNative));
+}
+
+void PyNumpyRNG::set_state(bp::object state)
+{
+	rngs::StateReader reader(fromBytes(state), 'M');
+	bp::object const entropy = readInt(reader);
+	bp::list spawn_key;
+	for (std::uint64_t ii = 0, n = reader.integer(); ii < n; ++ii) {
+		spawn_key.append(reader.integer());
+	}
+	std::uint64_t const pool_size = reader.integer();
+	bp::list key;
+	for (std::uint64_t ii = 0, n = reader.integer(); ii < n; ++ii) {
+		key.append(reader.integer());
+	}
+	std::uint64_t const pos = reader.integer();
+	std::uint64_t const spawned = reader.integer();
+	auto engine = mNative->raw();
+	reader.engine(engine);
+	reader.finish();
+
+	bp::dict mt;
+	mt["key"] = bp::import("numpy").attr("array")(key, "uint32");
+	mt["pos"] = pos;
+	bp::dict bit_generator_state;
+	bit_generator_state["bit_generator"] = "MT19937";
+	bit_generator_state["state"] = mt;
+	{
+		LockBitGenerator const lock(mState->lock);
+		mState->bitGenerator.attr("state") = bit_generator_state;
+	}
+
+	bp::dict kwargs;
+	kwargs["spawn_key"] = bp::tuple(spawn_key);
+	kwargs["pool_size"] = pool_size;
+	mState->seedSequence = bp::import("numpy.random").attr("SeedSequence")(
+		*bp::make_tuple(entropy), **kwargs);
+	mState->spawned = spawned;
+	mNative->raw() = engine;
+}
+
+boost::shared_ptr<RandomGenerator> PyNumpyRNG::_getRNG() const
+{
+	return mNative;
+}
+
+boost::shared_ptr<RandomDistribution>
+PyNumpyRNG::_getRandomDistribution(
+        std::string distribution,
+        bp::list parameters) const
+{
+	auto proxy = create_NRDProxy(distribution, mNative, parameters);
+	return proxy->get_distribution();
+}
+
+namespace {
+
+// Draws as GSL's sampling functions do on a gsl_rng_mt19937, whose seeding and
+// output equal those of std::mt19937 (seed 0 is replaced by GSL's default).
+struct FillGSL
+{
+	// gsl_rng_uniform
+	double uniform() const
+	{
+		return (*engine)() / 4294967296.;
+	}
+
+	// gsl_rng_uniform_pos
+	double uniformPos() const
+	{
+		double u;
+		do {
+			u = uniform();
+		} while (u == 0.);
+		return u;
+	}
+
+	// gsl_ran_flat
+	void operator()(transforms::Uniform const& d, size_t n, double* out) const
+	{
+		for (size_t ii = 0; ii < n; ++ii) {
+			double const u = uniform();
+			out[ii] = d.low * (1. - u) + d.high * u;
+		}
+	}
+
+	// gsl_ran_gaussian, Marsaglia's polar method using one value per pair
+	void operator()(transforms::Normal const& d, size_t n, double* out) const
+	{
+		for (size_t ii = 0; ii < n; ++ii) {
+			double x, y, r2;
+			do {
+				x = -1. + 2. * uniformPos();
+				y = -1. + 2. * uniformPos();
+				r2 = x * x + y * y;
+			} while (r2 > 1. || r2 == 0.);
+			out[ii] = d.mu + d.sigma * y * std::sqrt(-2. * std::log(r2) / r2);
+		}
+	}
+
+	// gsl_ran_exponential
+	void operator()(transforms::Exponential const& d, size_t n, double* out) const
+	{
+		for (size_t ii = 0; ii < n; ++ii) {
+			out[ii] = -d.scale * std::log1p(-uniform());
+		}
+	}
+
+	// gsl_rng_uniform_int
+	void operator()(transforms::Integer const& d, size_t n, std::int64_t* out) const
+	{
+		std::uint64_t const max = std::mt19937::max();
+		if (d.range == 0 || d.range > max) {
+			throw std::invalid_argument("randint range exceeds the generator's range");
+		}
+
+		std::uint64_t const scale = max / d.range;
+		for (size_t ii = 0; ii < n; ++ii) {
+			std::uint64_t k;
+			do {
+				k = (*engine)() / scale;
+			} while (k >= d.range);
+			out[ii] = d.low + static_cast<std::int64_t>(k);
+		}
+	}
+
+	std::mt19937* engine;
+};
+
+// Draws the local values of n values. Uniform and exponential values take
+// one engine value each, values of other processes are skipped by discarding
+// engine values. The other distributions draw a varying amount of engine
+// values, all n values are drawn there.
+struct FillGSLMasked
+{
+	void operator()(transforms::Uniform const& d, size_t, double* out) const
+	{
+		skip(d, out);
+	}
+
+	void operator()(transforms::Exponential const& d, size_t, double* out) const
+	{
+		skip(d, out);
+	}
+
+	template <typename Distribution>
+	void operator()(Distribution const& d, size_t, typename Distribution::result_type* out) const
+	{
+		std::vector<typename Distribution::result_type> all(local.size());
+		base(d, all.size(), all.data());
+		for (size_t ii = 0; ii < all.size(); ++ii) {
+			if (local[ii]) {
+				*out++ = all[ii];
+			}
+		}
+	}
+
+	template <typename Distribution>
+	void skip(Distribution const& d, typename Distribution::result_type* out) const
+	{
+		for (size_t ii = 0; ii < local.size();) {
+			size_t jj = ii;
+			while (jj < local.size() && local[jj] == local[ii]) {
+				++jj;
+			}
+			if (local[ii]) {
+				base(d, jj - ii, out);
+				out += jj - ii;
+			} else {
+				base.engine->discard(jj - ii);
+			}
+			ii = jj;
+		}
+	}
+
+	FillGSL base;
+	std::vector<char> local;
+};
+
+std::mt19937::result_type gslSeed(random_int_t seed)
+{
+	// gsl_rng_mt19937 replaces 0 by 4357
+	return seed ? static_cast<std::mt19937::result_type>(seed) : 4357;
+}
+
+std::string gslState(std::mt19937 const& engine, NativeRandomGenerator& native)
+{
+	rngs::StateWriter writer('G');
+	writer.engine(engine);
+	writer.engine(native.raw());
+	return writer.data();
+}
+
+} // anonymous namespace
+
+PyGSLRNG::PyGSLRNG() :
+	PyGSLRNG(std::random_device()())
+{
+}
+
+PyGSLRNG::PyGSLRNG(random_int_t seed) :
+	mSeed(seed),
+	mEngine(boost::make_shared<std::mt19937>(gslSeed(seed))),
+	mNative(boost::make_shared<NativeRandomGenerator>(seed))
+{
+	std::mt19937 const* const engine = mEngine.get();
+	NativeRandomGenerator* const native = mNative.get();
+	rngs::add(mEngine, "GSLRNG(seed=" + std::to_string(seed) + ")",
+	          [engine, native]() { return gslState(*engine, *native); });
+}
+
+bp::object PyGSLRNG::next(size_t n,
+				std::string distribution,
+				bp::list parameters,
+				bp::object mask_local)
+{
+	FillGSL const fill = {mEngine.get()};
+	if (isMasked(mask_local)) {
+		pyublas::numpy_vector<bool> const mask = localMask(n, mask_local);
+		FillGSLMasked masked = {fill, std::vector<char>(n)};
+		size_t count = 0;
+		for (size_t ii = 0; ii < n; ++ii) {
+			masked.local[ii] = mask[ii];
+			count += mask[ii];
+		}
+		return draw(distribution, parameters, count, false, masked);
+	}
+	return draw(distribution, parameters, n, n == 1, fill);
+}
+
+bp::list PyGSLRNG::spawn(size_t k)
+{
+	bp::list children;
+	for (size_t ii = 0; ii < k; ++ii) {
+		children.append(PyGSLRNG(static_cast<random_int_t>((*mEngine)())));
+	}
+	return children;
+}
+
+random_int_t PyGSLRNG::seed() const
+{
+	return mSeed;
+}
+
+bp::object PyGSLRNG::get_state() const
+{
+	return toBytes(gslState(*mEngine, *mNative));
+}
+
+void PyGSLRNG::set_state(bp::object state)
+{
+	rngs::StateReader reader(fromBytes(state), 'G');
+	std::mt19937 engine;
+	reader.engine(engine);
+	auto native = mNative->raw();
+	reader.engine(native);
+	reader.finish();
+
+	*mEngine = engine;
+	mNative->raw() = native;
 }
 
-PyNumpyRNG::PyNumpyRNG(random_int_t)
+boost::shared_ptr<RandomGenerator> PyGSLRNG::_getRNG() const
 {
-    NOT_IMPLEMENTED();
+	return mNative;
 }
 
-PyGSLRNG::PyGSLRNG()
+boost::shared_ptr<RandomDistribution>
+PyGSLRNG::_getRandomDistribution(
+        std::string distribution,
+        bp::list parameters) const
 {
-    NOT_IMPLEMENTED();
+	auto proxy = create_NRDProxy(distribution, mNative, parameters);
+	return proxy->get_distribution();
 }
 
-PyGSLRNG::PyGSLRNG(random_int_t)
+std::uint64_t drawSeed(bp::object rng)
 {
-    NOT_IMPLEMENTED();
+	bp::list parameters;
+	parameters.append(0);
+	parameters.append(2147483647);
+	bp::object const values = rng.attr("next")(3, "randint", parameters);
+	std::uint64_t seed = 0;
+	for (int ii = 0; ii < 3; ++ii) {
+		bp::object const value = values[ii];
+		bp::object const as_int(bp::handle<>(PyNumber_Long(value.ptr())));
+		seed = (seed << 31) ^ bp::extract<std::uint64_t>(as_int)();
+	}
+	return seed;
 }
 
 PyRandomDistribution::PyRandomDistribution(
@@ -321,7 +1234,9 @@ PyRandomDistribution::PyRandomDistribution(
 		const PyAbstractRNG & rng,
 		bp::object boundaries,
 		std::string constrain
-) {
+) :
+	mBuffers(boost::make_shared<Buffers>())
+{
 	_impl = rng._getRandomDistribution(distribution, parameters);
 	if(!_impl)
 	{
@@ -352,47 +1267,113 @@ PyRandomDistribution::PyRandomDistribution(
 		}
 		else
 		{
-			_impl->setBoundaries(c,
-			                     bp::extract<distribution_float_t>(boundaries[0]),
-			                     bp::extract<distribution_float_t>(boundaries[1]));
+			distribution_float_t const low = bp::extract<distribution_float_t>(boundaries[0]);
+			distribution_float_t const high = bp::extract<distribution_float_t>(boundaries[1]);
+			_impl->setBoundaries(c, low, high);
+
+			// The simulator side keeps redrawing, draws from python and
+			// rset() map uniform values instead.
+			if (c == RandomDistribution::REDRAW &&
+			    (distribution == "uniform" || distribution == "normal" ||
+			     distribution == "exponential"))
+			{
+				std::vector<double> values;
+				for (int ii = 0; ii < bp::len(parameters); ++ii) {
+					values.push_back(bp::extract<double>(parameters[ii]));
+				}
+				bp::list unit;
+				unit.append(0.);
+				unit.append(1.);
+				mUniform = rng._getRandomDistribution("uniform", unit);
+				if (mUniform) {
+					mTruncated = truncated::create(distribution, values, low, high);
+				}
+			}
 		}
 	}
 }
 
-bp::object PyRandomDistribution::next(size_t n)
+void PyRandomDistribution::_next(std::vector<distribution_float_t>& values) const
 {
-	if (n == 1)
-	{
-		if (_impl->type() == RandomDistribution::REAL)
-		{
-			distribution_float_t v;
-			_impl->next(v);
-			return bp::object(v);
-		}
-		else
-		{
-			NOT_IMPLEMENTED();
-		}
+	if (mTruncated) {
+		mUniform->next(values);
+		mTruncated->transform(values.data(), values.size());
+	} else {
+		_impl->next(values);
 	}
-	else
-	{
-		if (_impl->type() == RandomDistribution::REAL)
-		{
-			pyublas::numpy_vector<distribution_float_t> v(n);
-			std::vector<distribution_float_t> tmp(n);
-			_impl->next(tmp);
-			std::copy(tmp.begin(), tmp.end(), v.as_ublas().begin());
-			return bp::object(v);
-		}
-		else
-		{
-			pyublas::numpy_vector<distribution_int_t> v(n);
-			std::vector<distribution_int_t> tmp(n);
-			_impl->next(tmp);
-			std::copy(tmp.begin(), tmp.end(), v.as_ublas().begin());
-			return bp::object(v);
-		}
+}
+
+// euter's RandomDistribution fills vectors only. The scratch vectors are kept
+// with the distribution and shared by its copies, such that repeated draws do
+// not allocate. Buffers grown beyond maxRetained values by a large draw are
+// released afterwards.
+struct PyRandomDistribution::Buffers
+{
+	std::vector<distribution_float_t> real;
+	std::vector<distribution_int_t> integer;
+};
+
+namespace {
+
+// capacity of the scratch vectors kept between draws
+size_t const maxRetained = 1 << 16;
+
+// Returns out as array to draw values of type T into, it has to be used
+// directly (writable, contiguous and of matching dtype), otherwise the draws
+// would end up in a converted copy.
+template <typename T>
+pyublas::numpy_vector<T> outputArray(bp::object const& out)
+{
+	bp::object const dtype = bp::object(pyublas::numpy_vector<T>()).attr("dtype");
+	std::string const message = "out must be a writable contiguous array of dtype " +
+		std::string(bp::extract<std::string>(bp::str(dtype)));
+	// other objects may lack dtype and flags
+	bp::object const ndarray = bp::import("numpy").attr("ndarray");
+	if (!PyObject_IsInstance(out.ptr(), ndarray.ptr())) {
+		throw std::invalid_argument(message);
+	}
+	bp::extract<pyublas::numpy_vector<T> > array(out);
+	bp::object const flags = out.attr("flags");
+	if (!array.check() || !bp::extract<bool>(out.attr("dtype") == dtype)
+	    || !bp::extract<bool>(flags["C_CONTIGUOUS"]) || !bp::extract<bool>(flags["WRITEABLE"])) {
+		throw std::invalid_argument(message);
+	}
+	return array();
+}
+
+// Draws into buffer with fill(buffer) and returns the values as scalar, new
+// array or in out.
+template <typename T, typename Fill>
+bp::object drawInto(Fill const& fill, std::vector<T>& buffer, size_t n, bp::object const& out)
+{
+	if (out.is_none() && n == 1) {
+		buffer.resize(1);
+		fill(buffer);
+		return bp::object(buffer[0]);
+	}
+
+	pyublas::numpy_vector<T> values = out.is_none()
+		? pyublas::numpy_vector<T>(n) : outputArray<T>(out);
+	buffer.resize(values.size());
+	fill(buffer);
+	std::copy(buffer.begin(), buffer.end(), values.as_ublas().begin());
+	if (buffer.capacity() > maxRetained) {
+		std::vector<T>().swap(buffer);
+	}
+	return out.is_none() ? bp::object(values) : out;
+}
+
+} // anonymous namespace
+
+bp::object PyRandomDistribution::next(size_t n, bp::object out)
+{
+	if (_impl->type() == RandomDistribution::INT) {
+		RandomDistribution& dist = *_impl;
+		return drawInto([&dist](std::vector<distribution_int_t>& values) { dist.next(values); },
+		                mBuffers->integer, n, out);
 	}
+	return drawInto([this](std::vector<distribution_float_t>& values) { _next(values); },
+	                mBuffers->real, n, out);
 }
 
 boost::shared_ptr<RandomDistribution> PyRandomDistribution::_getDist() const
@@ -1,11 +1,14 @@
 #pragma once
 
+#include <cstdint>
+#include <random>
 #include <string>
 #include <vector>
 
 #include "shared_ptr_fwd.h"
 
 #include "pyhmf/boost_python_fwd.h"
+#include "pyublas.h"
 #include "euter/random_traits.h"
 
 namespace euter {
@@ -13,16 +16,24 @@ class RandomGenerator;
 class RandomDistribution;
 }
 
+namespace truncated {
+class Sampler;
+}
+
 class PyAbstractRNG
 {
 public:
-	typedef size_t mask_local_t;
+	typedef bp::object mask_local_t;
 	virtual ~PyAbstractRNG();
 
+	/// Draws n values of the distribution. As in PyNN, a boolean array
+	/// mask_local of size n selects the values returned while the RNG still
+	/// advances by n values, such that every process gets the values of its
+	/// cells independent of the number of processes. None or False select all.
 	virtual bp::object next(size_t n = 1,
 			std::string distribution = "uniform",
 			bp::list parameters = SentinelKeeper::emptyPyList,
-			size_t mask_local = 0) = 0;
+			bp::object mask_local = SentinelKeeper::emptyPyObject) = 0;
 
 	// Cant be pure virtual because it is not exposed to python :(
 	virtual boost::shared_ptr<euter::RandomDistribution> _getRandomDistribution(
@@ -42,13 +53,33 @@ public:
 	PyNativeRNG();
 	PyNativeRNG(euter::random_int_t seed);
 
+	/// Values masked off by mask_local are drawn and dropped, euter's
+	/// distributions take a distribution dependent amount of engine values per
+	/// value, such that they can't be skipped.
 	virtual bp::object next(size_t n = 1,
 			std::string distribution = "uniform",
 			bp::list parameters = SentinelKeeper::emptyPyList,
-			size_t mask_local = 0);
+			bp::object mask_local = SentinelKeeper::emptyPyObject);
+
+	/// Returns k RNGs seeded from this one. The engine provides no jump ahead,
+	/// the streams are independent only with high probability.
+	bp::list spawn(size_t k);
+
+	/// Returns the state as compact bytes, set_state() restores it.
+	bp::object get_state() const;
+	/// Raises a ValueError if the state belongs to another kind of RNG.
+	void set_state(bp::object state);
 
     bp::list permutation(bp::list const& lin);
 
+	/// Returns a random permutation of 0, ..., n - 1, equal to shuffling
+	/// arange(n).
+	pyublas::numpy_vector<long> permutation(size_t n);
+
+	/// Shuffles a C-contiguous array in place along its first axis without
+	/// additional memory per item.
+	void shuffle(bp::object array);
+
 	euter::distribution_int_t randint(euter::distribution_int_t a, euter::distribution_int_t b);
 	euter::distribution_int_t randint(euter::distribution_int_t b);
 	euter::distribution_float_t uniform(euter::distribution_float_t a, euter::distribution_float_t b);
@@ -69,20 +100,194 @@ private:
 	boost::shared_ptr<euter::NativeRandomGenerator> _impl;
 };
 
+/// Counter-based RNG (Philox4x32-10).
+///
+/// Value i of a stream only depends on seed, stream and i. Values can thus be
+/// drawn in any order and on any number of threads, at() draws values at
+/// arbitrary positions without advancing the RNG. Supported distributions are
+/// uniform [low, high), normal [mu, sigma], exponential [beta] and randint
+/// [low, high] (inclusive as for NativeRNG).
+class PyCounterRNG : public PyAbstractRNG
+{
+public:
+	PyCounterRNG(std::uint64_t seed = 0, std::uint64_t stream = 0);
+
+	virtual bp::object next(size_t n = 1,
+			std::string distribution = "uniform",
+			bp::list parameters = SentinelKeeper::emptyPyList,
+			bp::object mask_local = SentinelKeeper::emptyPyObject);
+
+	/// Returns k RNGs on new streams of the same seed. The stream ids are
+	/// drawn from the reserved end of this stream, repeated calls return new
+	/// streams.
+	bp::list spawn(size_t k);
+
+	/// Returns the values at the given positions of the stream, the position
+	/// of the RNG is not changed.
+	bp::object at(pyublas::numpy_vector<long> const& positions,
+			std::string distribution = "uniform",
+			bp::list parameters = SentinelKeeper::emptyPyList) const;
+
+	std::uint64_t seed() const;
+	std::uint64_t stream() const;
+
+	/// Position of the next value drawn by next()
+	std::uint64_t position() const;
+	void seek(std::uint64_t position);
+
+	/// Returns the state as compact bytes including the position and the
+	/// number of spawned streams, set_state() restores it.
+	bp::object get_state() const;
+	/// Raises a ValueError if the state belongs to another kind of RNG.
+	void set_state(bp::object state);
+
+	/// Distributions for the simulator are backed by a native RNG seeded from
+	/// seed and stream.
+	virtual boost::shared_ptr<euter::RandomDistribution> _getRandomDistribution(
+        std::string distribution,
+        bp::list parameters) const;
+
+	virtual boost::shared_ptr<euter::RandomGenerator> _getRNG() const;
+
+private:
+	// shared by copies, such that the registered state follows all of them
+	struct State
+	{
+		std::uint64_t seed;
+		std::uint64_t stream;
+		std::uint64_t position;
+		std::uint64_t spawned;
+	};
+
+	static std::string dump(State const& state, euter::NativeRandomGenerator& native);
+
+	boost::shared_ptr<State> mState;
+	boost::shared_ptr<euter::NativeRandomGenerator> mNative;
+};
+
+/// RNG drawing from a numpy bit generator (MT19937) through its C interface,
+/// i.e. without a python call per number. The distributions are those of
+/// PyCounterRNG, uniform values equal those drawn by numpy's Generator.random()
+/// on the same bit generator. Draws hold the bit generator's lock.
+///
+/// Divergences from numpy:
+///  - A seeded RNG starts as numpy.random.RandomState(seed), i.e. uniform
+///    values equal RandomState(seed).random_sample(). Spawned RNGs are seeded
+///    from SeedSequence(seed) instead, as numpy's spawn() would do.
+///  - Normal, exponential and randint values are transformed as by
+///    PyCounterRNG and thus differ from numpy's.
+///  - randint [low, high] includes high, as for the other RNGs of this module,
+///    while numpy excludes it.
 class PyNumpyRNG : public PyAbstractRNG
 {
 public:
 	PyNumpyRNG();
 	PyNumpyRNG(euter::random_int_t seed);
+
+	virtual bp::object next(size_t n = 1,
+			std::string distribution = "uniform",
+			bp::list parameters = SentinelKeeper::emptyPyList,
+			bp::object mask_local = SentinelKeeper::emptyPyObject);
+
+	/// Returns k RNGs whose bit generators are seeded from children of this
+	/// one's SeedSequence, as numpy's SeedSequence.spawn() does. Repeated and
+	/// nested calls return independent streams.
+	bp::list spawn(size_t k);
+
+	/// The underlying numpy.random.BitGenerator
+	bp::object bit_generator() const;
+
+	/// Returns the state as compact bytes, set_state() restores it.
+	bp::object get_state() const;
+	/// Raises a ValueError if the state belongs to another kind of RNG.
+	void set_state(bp::object state);
+
+
+	/// Distributions for the simulator are backed by a native RNG seeded with
+	/// the same seed.
+	virtual boost::shared_ptr<euter::RandomDistribution> _getRandomDistribution(
+        std::string distribution,
+        bp::list parameters) const;
+
+	virtual boost::shared_ptr<euter::RandomGenerator> _getRNG() const;
+
+private:
+	struct BitGenerator;
+
+	PyNumpyRNG(bp::object seed_sequence, euter::random_int_t seed);
+
+	void init(bp::object seed_sequence, bp::object bit_generator);
+
+	// shared by copies, such that the registered state follows all of them
+	struct State
+	{
+		// numpy.random.SeedSequence the bit generator was seeded from
+		bp::object seedSequence;
+		bp::object bitGenerator;
+		// threading lock of the bit generator
+		bp::object lock;
+		size_t spawned;
+	};
+
+	static std::string dump(State const& state, euter::NativeRandomGenerator& native);
+
+	boost::shared_ptr<State> mState;
+	// owned by the bit generator
+	BitGenerator* mBitGen;
+	boost::shared_ptr<euter::NativeRandomGenerator> mNative;
 };
 
+/// GSL-compatible RNG: draws equal those of GSL's gsl_ran_flat,
+/// gsl_ran_gaussian, gsl_ran_exponential and gsl_rng_uniform_int on a
+/// gsl_rng_mt19937 with the same seed, without depending on GSL. Supported
+/// distributions are uniform [low, high], normal [mu, sigma], exponential
+/// [beta] and randint [low, high] (inclusive as for NativeRNG).
+/// Values masked off by mask_local are skipped by discarding engine values for
+/// uniform and exponential, which is linear in their number but avoids the
+/// transformation. Normal and randint draw a varying amount of engine values
+/// per value, there all values are drawn.
 class PyGSLRNG : public PyAbstractRNG
 {
 public:
+	/// Seeded from the system's random device as done by PyNN
 	PyGSLRNG();
 	PyGSLRNG(euter::random_int_t seed);
+
+	virtual bp::object next(size_t n = 1,
+			std::string distribution = "uniform",
+			bp::list parameters = SentinelKeeper::emptyPyList,
+			bp::object mask_local = SentinelKeeper::emptyPyObject);
+
+	/// Returns k RNGs seeded from this one's engine. mt19937 provides no jump
+	/// ahead, the streams are independent only with high probability.
+	bp::list spawn(size_t k);
+
+	euter::random_int_t seed() const;
+
+	/// Returns the state as compact bytes, set_state() restores it.
+	bp::object get_state() const;
+	/// Raises a ValueError if the state belongs to another kind of RNG.
+	void set_state(bp::object state);
+
+	/// Distributions for the simulator are backed by a native RNG seeded with
+	/// the same seed.
+	virtual boost::shared_ptr<euter::RandomDistribution> _getRandomDistribution(
+        std::string distribution,
+        bp::list parameters) const;
+
+	virtual boost::shared_ptr<euter::RandomGenerator> _getRNG() const;
+
+private:
+	euter::random_int_t mSeed;
+	boost::shared_ptr<std::mt19937> mEngine;
+	boost::shared_ptr<euter::NativeRandomGenerator> mNative;
 };
 
+/// Draws a 64 bit seed from a PyNN RNG, combined from three values as RNGs
+/// draw 31 bit integers only. Using the generic python interface allows
+/// native as well as python RNGs.
+std::uint64_t drawSeed(bp::object rng);
+
 class PyRandomDistribution {
 public:
 	PyRandomDistribution(
@@ -93,10 +298,25 @@ public:
 		std::string constrain = "clip"
 	);
 
-	bp::object next(size_t n = 1);
+	/// Draws n values, a single one is returned as scalar. If out is given it
+	/// is filled and returned instead, its size determines the number of
+	/// draws. It must be a writable contiguous array of the distribution's
+	/// dtype (float64, or int for integer distributions).
+	bp::object next(size_t n = 1, bp::object out = SentinelKeeper::emptyPyObject);
+
+	/// Draws values.size() values as _getDist()->next(values), but samples
+	/// uniform, normal and exponential distributions constrained by redrawing
+	/// through the inverse CDF of the truncated distribution.
+	void _next(std::vector<euter::distribution_float_t>& values) const;
 
 	boost::shared_ptr<euter::RandomDistribution> _getDist() const;
 private:
+	struct Buffers;
+
 	boost::shared_ptr<euter::RandomDistribution> _impl;
+	boost::shared_ptr<Buffers> mBuffers;
+	// uniform values in [0, 1) for the truncated sampler
+	boost::shared_ptr<euter::RandomDistribution> mUniform;
+	boost::shared_ptr<truncated::Sampler const> mTruncated;
 };
 
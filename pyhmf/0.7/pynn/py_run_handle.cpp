@@ -0,0 +1,132 @@
+#include "py_run_handle.h"
+
+#include <algorithm>
+#include <chrono>
+#include <future>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+#include <boost/make_shared.hpp>
+#include <boost/python/make_function.hpp>
+
+#include "pyhmf/boost_python.h"
+#include "gil.h"
+
+// The worker only uses the task and the promise, it never touches python.
+// The state joins the worker before it is destroyed, thus the task, which may
+// own python objects (e.g. metadata of the store), is released by a python
+// thread holding the GIL.
+struct PyRunHandle::State
+{
+	~State()
+	{
+		join();
+	}
+
+	// Waits for the worker with the GIL released
+	void join()
+	{
+		ReleaseGIL const release;
+		std::lock_guard<std::mutex> const lock(mutex);
+		if (worker.joinable()) {
+			worker.join();
+		}
+	}
+
+	double simtime;
+	std::function<void()> task;
+	std::promise<void> promise;
+	std::shared_future<void> future;
+	std::mutex mutex;
+	std::thread worker;
+};
+
+std::vector<boost::weak_ptr<PyRunHandle::State> >& PyRunHandle::pending()
+{
+	static std::vector<boost::weak_ptr<State> > instance;
+	return instance;
+}
+
+// Called by python's atexit, such that no worker outlives the interpreter.
+void PyRunHandle::joinPending()
+{
+	std::vector<boost::weak_ptr<State> > all;
+	all.swap(pending());
+	for (auto const& entry : all) {
+		if (boost::shared_ptr<State> const state = entry.lock()) {
+			state->join();
+		}
+	}
+}
+
+PyRunHandle::PyRunHandle(boost::shared_ptr<State> const& state) :
+	mState(state)
+{
+}
+
+PyRunHandle PyRunHandle::_start(double simtime, std::function<void()> task)
+{
+	static bool const registered = [] {
+		bp::import("atexit").attr("register")(bp::make_function(&joinPending));
+		return true;
+	}();
+	static_cast<void>(registered);
+
+	std::vector<boost::weak_ptr<State> >& all = pending();
+	all.erase(std::remove_if(all.begin(), all.end(),
+	                         [](boost::weak_ptr<State> const& s) { return s.expired(); }),
+	          all.end());
+
+	boost::shared_ptr<State> const state = boost::make_shared<State>();
+	state->simtime = simtime;
+	state->task = task;
+	state->future = state->promise.get_future().share();
+
+	std::function<void()>* const work = &state->task;
+	std::promise<void>* const promise = &state->promise;
+	state->worker = std::thread([work, promise]() {
+		try {
+			(*work)();
+			promise->set_value();
+		} catch (...) {
+			promise->set_exception(std::current_exception());
+		}
+	});
+	all.push_back(state);
+
+	return PyRunHandle(state);
+}
+
+bool PyRunHandle::done() const
+{
+	return mState->future.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+}
+
+bool PyRunHandle::wait(bp::object timeout) const
+{
+	if (timeout.is_none()) {
+		ReleaseGIL const release;
+		mState->future.wait();
+		return true;
+	}
+
+	double const seconds = bp::extract<double>(timeout);
+	ReleaseGIL const release;
+	return mState->future.wait_for(std::chrono::duration<double>(seconds)) ==
+	       std::future_status::ready;
+}
+
+int PyRunHandle::result(bp::object timeout) const
+{
+	if (!wait(timeout)) {
+		throw std::runtime_error("Run did not finish within the timeout");
+	}
+	mState->future.get();
+	return 1;
+}
+
+double PyRunHandle::simtime() const
+{
+	return mState->simtime;
+}
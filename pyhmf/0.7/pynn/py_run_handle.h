@@ -0,0 +1,54 @@
+#pragma once
+
+#include <vector>
+#include <boost/shared_ptr.hpp>
+#include <boost/weak_ptr.hpp>
+#include "pyhmf/boost_python_fwd.h"
+#include "std_function.h"
+
+/// Handle of a run started by run_async().
+///
+/// The run works on a copy of the store taken at the start, such that the next
+/// experiment can be built meanwhile, e.g. in another Session. The copy shares
+/// the populations and projections with the caller's network, results are
+/// written into them as by run() and are read by getSpikes(), get_v(), ...
+/// once the run is done. Objects of the running network must not be modified
+/// until then. This includes the metadata passed to setup(), e.g. the
+/// PyMarocco object, which is shared with the copy: the next experiment has
+/// to be set up with another one until done() returns true.
+/// Pending runs are waited for when the interpreter exits.
+class PyRunHandle
+{
+public:
+	/// Returns true if the run finished, successfully or not.
+	bool done() const;
+
+	/// Waits until the run finished or timeout seconds passed (forever for
+	/// None), the GIL is released meanwhile. Returns done().
+	bool wait(bp::object timeout = SentinelKeeper::emptyPyObject) const;
+
+	/// Waits as wait() and returns the return value of run(), i.e. 1, as the
+	/// data is read from the network's objects. Exceptions of the run are
+	/// raised here, a RuntimeError if the run did not finish within the
+	/// timeout.
+	int result(bp::object timeout = SentinelKeeper::emptyPyObject) const;
+
+	/// Emulated time in ms as passed to run_async()
+	double simtime() const;
+
+	/// Runs task on a new thread without the GIL.
+	static PyRunHandle _start(double simtime, std::function<void()> task);
+
+private:
+	struct State;
+
+	/// Runs which may still be running
+	static std::vector<boost::weak_ptr<State> >& pending();
+
+	/// Joins all pending runs, registered with python's atexit.
+	static void joinPending();
+
+	explicit PyRunHandle(boost::shared_ptr<State> const& state);
+
+	boost::shared_ptr<State> mState;
+};
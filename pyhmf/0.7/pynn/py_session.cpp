@@ -0,0 +1,67 @@
+#include "py_session.h"
+
+#include <stdexcept>
+#include <vector>
+
+#include "pyhmf/boost_python.h"
+#include "pyhmf/objectstore.h"
+
+namespace {
+
+// sessions active before enter() of the calling thread, nested with blocks
+// form a stack
+thread_local std::vector<boost::shared_ptr<Session> > entered;
+
+} // anonymous namespace
+
+PySession::PySession() :
+	_impl(new Session)
+{
+}
+
+PySession::PySession(boost::shared_ptr<Session> const& impl) :
+	_impl(impl)
+{
+}
+
+void PySession::activate()
+{
+	Session::activate(_impl);
+}
+
+PySession PySession::enter()
+{
+	entered.push_back(Session::activate(_impl));
+	return *this;
+}
+
+bool PySession::exit(bp::object, bp::object, bp::object)
+{
+	if (entered.empty()) {
+		throw std::runtime_error("Session was not entered in this thread");
+	}
+	Session::activate(entered.back());
+	entered.pop_back();
+	// exceptions are not suppressed
+	return false;
+}
+
+bool PySession::operator==(PySession const& other) const
+{
+	return _impl == other._impl;
+}
+
+bool PySession::operator!=(PySession const& other) const
+{
+	return !(*this == other);
+}
+
+PySession get_session()
+{
+	return PySession(Session::current());
+}
+
+PySession default_session()
+{
+	return PySession(Session::defaultSession());
+}
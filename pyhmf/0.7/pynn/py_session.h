@@ -0,0 +1,47 @@
+#pragma once
+
+#include <boost/shared_ptr.hpp>
+#include "pyhmf/boost_python_fwd.h"
+
+class Session;
+
+/// A separate network, i.e. its own ObjectStore together with the labels and
+/// recording selections of its objects.
+///
+/// The free functions (setup(), run(), get_population(), ...) and
+/// constructors act on the active session of the calling thread, which is the
+/// default session unless another one is activated. Use as
+///
+///     with pynn.Session():
+///         pynn.setup()
+///         ...
+class PySession
+{
+public:
+	PySession();
+
+	/// Makes this the active session of the calling thread.
+	void activate();
+
+	/// Activates the session for a with block, the previously active session
+	/// of the thread is restored on exit.
+	PySession enter();
+	bool exit(bp::object type, bp::object value, bp::object traceback);
+
+	bool operator==(PySession const& other) const;
+	bool operator!=(PySession const& other) const;
+
+private:
+	explicit PySession(boost::shared_ptr<Session> const& impl);
+
+	friend PySession get_session();
+	friend PySession default_session();
+
+	boost::shared_ptr<Session> _impl;
+};
+
+/// Returns the active session of the calling thread.
+PySession get_session();
+
+/// Returns the session used by threads without an active session.
+PySession default_session();
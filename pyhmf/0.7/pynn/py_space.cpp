@@ -2,7 +2,10 @@
 #include "py_space.h"
 #include "euter/exceptions.h"
 #include "errors.h"
+#include "positions.h"
 
+#include <algorithm>
+#include <vector>
 #include <boost/numeric/ublas/io.hpp>
 
 using namespace euter;
@@ -23,6 +26,11 @@ PySpace::PySpace(
 	if(axes.find('z') != std::string::npos)
 		tmp_axes |= Space::Axis::Z;
 
+	mMetric.axes[0] = axes.find('x') != std::string::npos;
+	mMetric.axes[1] = axes.find('y') != std::string::npos;
+	mMetric.axes[2] = axes.find('z') != std::string::npos;
+	mMetric.scale = scale_factor;
+
 	// Extract offset vector
 	SpatialTypes::coord_type tmp_offset;
 	if(offset.ptr() == SentinelKeeper::emptyPyObject.ptr())  // mimic python is operator
@@ -47,6 +55,9 @@ PySpace::PySpace(
 		NOT_IMPLEMENTED();
 	}
 
+	for(size_t i=0; i<3; ++i)
+		mMetric.offset[i] = tmp_offset(i);
+
 	// Extract boundaries. Yay. Fun.
 	SpatialTypes::Boundaries boundaries;
 	double nan = std::numeric_limits<SpatialTypes::distance_type>::quiet_NaN();
@@ -72,6 +83,7 @@ PySpace::PySpace(
 				boundaries(i) = std::make_pair<double, double>(
 					bp::extract<double>(tpl_boundaries[i][0])(),
 					bp::extract<double>(tpl_boundaries[i][1])());
+				mMetric.period[i] = boundaries(i).second - boundaries(i).first;
 			}
 		}
 	}
@@ -79,29 +91,157 @@ PySpace::PySpace(
 	_impl = boost::make_shared<Space>(tmp_axes, scale_factor, tmp_offset, boundaries);
 }
 
-py_matrix_type PySpace::distances(py_vector_type A, py_vector_type B, bool expand)
+namespace {
+
+template <typename T>
+T* data(pyublas::numpy_vector<T>& v)
+{
+	return v.size() ? &v.as_ublas()[0] : nullptr;
+}
+
+template <typename T>
+bp::object distances(distance::Metric const& metric,
+                     distance::Positions const& a,
+                     distance::Positions const& b,
+                     bool expand)
 {
+	size_t const planes = expand ? metric.dimensions() : 1;
+	pyublas::numpy_vector<T> result(planes * a.size * b.size);
+	distance::distances(metric, a, b, data(result), expand);
+
 	if(expand)
-		NOT_IMPLEMENTED();
+	{
+		const long shape[3] = {static_cast<long>(planes), static_cast<long>(a.size),
+		                       static_cast<long>(b.size)};
+		result.reshape(3, shape);
+	}
+	else
+	{
+		const long shape[2] = {static_cast<long>(a.size), static_cast<long>(b.size)};
+		result.reshape(2, shape);
+	}
+	return bp::object(result);
+}
 
-	ublas::vector<SpatialTypes::coord_type> a(A.dims()[1]);
-	ublas::vector<SpatialTypes::coord_type> b(B.dims()[1]);
+template <typename T>
+void distanceTiles(distance::Metric const& metric,
+                   distance::Positions const& a,
+                   distance::Positions const& b,
+                   bp::object callback,
+                   size_t rows,
+                   size_t columns)
+{
+	std::vector<double> const tb = distance::transform(metric, b);
+	distance::Positions const pb(tb.data(), b.size);
 
-	for(int i=0; i<A.dims()[1]; ++i)
+	for(size_t i0 = 0; i0 < a.size; i0 += rows)
 	{
-		a[i] = SpatialTypes::coord_type();
-		for(int j=0; j<A.dims()[0]; ++j)
-			a[i][j] = A.sub(j, i);
+		size_t const i1 = std::min(i0 + rows, a.size);
+		for(size_t j0 = 0; j0 < b.size; j0 += columns)
+		{
+			size_t const j1 = std::min(j0 + columns, b.size);
+
+			// a new array per tile, as the callback may keep a reference
+			pyublas::numpy_vector<T> tile((i1 - i0) * (j1 - j0));
+			distance::tile(metric, a, pb, i0, i1, j0, j1, data(tile), j1 - j0);
+			const long shape[2] = {static_cast<long>(i1 - i0), static_cast<long>(j1 - j0)};
+			tile.reshape(2, shape);
+
+			callback(i0, j0, tile);
+		}
 	}
-	
-	for(int i=0; i<A.dims()[1]; ++i)
+}
+
+// Size of the tiles used by pairs_within, 8 MiB
+size_t const tile_rows = 256;
+size_t const tile_columns = 4096;
+
+} // anonymous namespace
+
+bp::object PySpace::distances(bp::object A, bp::object B, bool expand, std::string dtype) const
+{
+	pyublas::numpy_vector<double> a = positions::extract(A);
+	pyublas::numpy_vector<double> b = positions::extract(B);
+	distance::Positions const pa(data(a), a.size() / 3);
+	distance::Positions const pb(data(b), b.size() / 3);
+
+	if(dtype == "float64")
+		return ::distances<double>(mMetric, pa, pb, expand);
+	else if(dtype == "float32")
+		return ::distances<float>(mMetric, pa, pb, expand);
+	else
+		throw std::invalid_argument("dtype must be either \"float64\" or \"float32\"");
+}
+
+void PySpace::distance_tiles(bp::object A,
+                             bp::object B,
+                             bp::object callback,
+                             size_t rows,
+                             size_t columns,
+                             std::string dtype) const
+{
+	if(rows == 0 || columns == 0)
+		throw std::invalid_argument("Tiles must not be empty");
+
+	pyublas::numpy_vector<double> a = positions::extract(A);
+	pyublas::numpy_vector<double> b = positions::extract(B);
+	distance::Positions const pa(data(a), a.size() / 3);
+	distance::Positions const pb(data(b), b.size() / 3);
+
+	if(dtype == "float64")
+		distanceTiles<double>(mMetric, pa, pb, callback, rows, columns);
+	else if(dtype == "float32")
+		distanceTiles<float>(mMetric, pa, pb, callback, rows, columns);
+	else
+		throw std::invalid_argument("dtype must be either \"float64\" or \"float32\"");
+}
+
+bp::tuple PySpace::pairs_within(bp::object A, bp::object B, double threshold) const
+{
+	pyublas::numpy_vector<double> a = positions::extract(A);
+	pyublas::numpy_vector<double> b = positions::extract(B);
+	distance::Positions const pa(data(a), a.size() / 3);
+	distance::Positions const pb(data(b), b.size() / 3);
+
+	std::vector<double> const tb = distance::transform(mMetric, pb);
+	distance::Positions const tpb(tb.data(), pb.size);
+
+	std::vector<long> ii;
+	std::vector<long> jj;
+	std::vector<double> dd;
+	std::vector<double> tile(tile_rows * tile_columns);
+	for(size_t i0 = 0; i0 < pa.size; i0 += tile_rows)
 	{
-		b[i] = SpatialTypes::coord_type();
-		for(int j=0; j<B.dims()[0]; ++j)
-			b[i][j] = B.sub(j, i);
+		size_t const i1 = std::min(i0 + tile_rows, pa.size);
+		for(size_t j0 = 0; j0 < pb.size; j0 += tile_columns)
+		{
+			size_t const j1 = std::min(j0 + tile_columns, pb.size);
+			size_t const ld = j1 - j0;
+			distance::tile(mMetric, pa, tpb, i0, i1, j0, j1, tile.data(), ld);
+
+			for(size_t i = 0; i < i1 - i0; ++i)
+			{
+				double const* row = tile.data() + i * ld;
+				for(size_t j = 0; j < ld; ++j)
+				{
+					if(row[j] <= threshold)
+					{
+						ii.push_back(i0 + i);
+						jj.push_back(j0 + j);
+						dd.push_back(row[j]);
+					}
+				}
+			}
+		}
 	}
-	
-	return _impl->distances(a, b);
+
+	pyublas::numpy_vector<long> np_ii(ii.size());
+	pyublas::numpy_vector<long> np_jj(jj.size());
+	pyublas::numpy_vector<double> np_dd(dd.size());
+	std::copy(ii.begin(), ii.end(), np_ii.as_ublas().begin());
+	std::copy(jj.begin(), jj.end(), np_jj.as_ublas().begin());
+	std::copy(dd.begin(), dd.end(), np_dd.as_ublas().begin());
+	return bp::make_tuple(np_ii, np_jj, np_dd);
 }
 
 
@@ -5,6 +5,7 @@
 #include "pyublas.h"
 #include <Python.h>
 #include "euter/space.h"
+#include "distance.h"
 
 namespace euter {
 class Structure;
@@ -19,9 +20,36 @@ public:
 			bp::object offset=SentinelKeeper::emptyPyObject,
 			bp::object periodic_boundaries=SentinelKeeper::emptyPyObject
 		   );
-	py_matrix_type distances(py_vector_type A, py_vector_type B, bool expand=false);
+
+	/// Returns the distance matrix between the positions A and B, given as
+	/// (3, n) arrays. With expand, the distances along each axis are returned
+	/// as (number of axes, n, m) array.
+	/// dtype selects the type of the result, either "float64" or "float32".
+	bp::object distances(bp::object A,
+	                     bp::object B,
+	                     bool expand=false,
+	                     std::string dtype="float64") const;
+
+	/// Calculates the distances between the positions A and B tile by tile,
+	/// without allocating the full distance matrix. For every tile
+	/// callback(i, j, tile) is called, where tile holds the distances between
+	/// A[:, i:i+rows] and B[:, j:j+columns] (smaller at the borders).
+	void distance_tiles(bp::object A,
+	                    bp::object B,
+	                    bp::object callback,
+	                    size_t rows=1024,
+	                    size_t columns=1024,
+	                    std::string dtype="float64") const;
+
+	/// Returns all pairs of positions in A and B that are at most threshold
+	/// apart as tuple of arrays (indices into A, indices into B, distances).
+	/// The distances are calculated tile by tile in bounded memory.
+	bp::tuple pairs_within(bp::object A, bp::object B, double threshold) const;
 
 	boost::shared_ptr<euter::Space> _impl;
+
+private:
+	distance::Metric mMetric;
 };
 
 class PyStructure
@@ -1,6 +1,11 @@
 #pragma once
 
 #include <pywrap/compat/numpy.hpp>
+#include "pyhmf/boost_python_fwd.h"
 
 typedef pyublas::numpy_matrix<double, boost::numeric::ublas::row_major> py_matrix_type;
 typedef pyublas::numpy_vector<double> py_vector_type;
+
+/// Returns obj as contiguous array of long, accepting arrays of any integer
+/// dtype and sequences of integers. Raises a TypeError for other dtypes.
+pyublas::numpy_vector<long> extractIndices(bp::object const& obj);
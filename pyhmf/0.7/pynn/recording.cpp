@@ -0,0 +1,169 @@
+#include "recording.h"
+
+#include <array>
+#include <map>
+#include <boost/weak_ptr.hpp>
+
+#include "pyhmf/boost_python.h"
+#include "pyhmf/objectstore.h"
+#include "euter/population.h"
+#include "euter/population_view.h"
+#include "pycellparameters/pyparameteraccess.h"
+
+using namespace euter;
+
+namespace recording {
+
+namespace {
+
+struct Selection
+{
+	typedef std::array<boost::dynamic_bitset<>, NUM_VARIABLES> masks_type;
+
+	// Populations are owned by the ObjectStore, a weak reference allows to
+	// drop selections of populations that vanished with a reset of the store.
+	boost::weak_ptr<Population> population;
+	// cells selected for recording
+	masks_type selected;
+	// state as last written to the cell parameters
+	masks_type committed;
+};
+
+typedef std::map<Population const*, Selection> selections_type;
+
+// Selections are kept with the session the population was created in, the
+// session has to be kept alive while the selections are used.
+boost::shared_ptr<Session> session(PopulationView const& view)
+{
+	return Session::of(view.population_ptr().get());
+}
+
+selections_type& selections(Session& session)
+{
+	return session.registry<selections_type>();
+}
+
+char const* parameterName(Variable variable)
+{
+	static char const* const names[NUM_VARIABLES] = {
+		"record_spikes", "record_v", "record_gsyn"};
+	return names[variable];
+}
+
+Selection& getSelection(Session& session, PopulationView const& view)
+{
+	PopulationPtr const pop = view.population_ptr();
+	Selection& s = selections(session)[pop.get()];
+
+	// new entry or the address has been reused by a new population, no cell
+	// records initially
+	if (s.population.lock() != pop) {
+		s.population = pop;
+		for (size_t var = 0; var < NUM_VARIABLES; ++var) {
+			s.selected[var] = boost::dynamic_bitset<>(pop->size());
+			s.committed[var] = boost::dynamic_bitset<>(pop->size());
+		}
+	}
+	return s;
+}
+
+void setParameter(PopulationPtr const& pop,
+                  boost::dynamic_bitset<> const& cells,
+                  Variable variable,
+                  bool value)
+{
+	if (cells.none()) {
+		return;
+	}
+
+	PopulationView view(pop, cells);
+	bp::object const v(value);
+	std::vector<ParameterProxy> proxy = getPyParameterVector(view);
+	for (size_t ii = 0; ii < proxy.size(); ++ii) {
+		proxy[ii].set(parameterName(variable), v);
+	}
+}
+
+} // anonymous namespace
+
+bool fromParameterName(std::string const& name, Variable& variable)
+{
+	for (size_t var = 0; var < NUM_VARIABLES; ++var) {
+		if (name == parameterName(static_cast<Variable>(var))) {
+			variable = static_cast<Variable>(var);
+			return true;
+		}
+	}
+	return false;
+}
+
+void record(PopulationView const& view, Variable variable, bool value)
+{
+	boost::shared_ptr<Session> const owner = session(view);
+	Selection& s = getSelection(*owner, view);
+	if (value) {
+		s.selected[variable] |= view.mask();
+	} else {
+		s.selected[variable] -= view.mask();
+	}
+}
+
+void assign(PopulationView const& view,
+            Variable variable,
+            boost::dynamic_bitset<> const& values)
+{
+	boost::shared_ptr<Session> const owner = session(view);
+	boost::dynamic_bitset<>& selected = getSelection(*owner, view).selected[variable];
+	boost::dynamic_bitset<> const& mask = view.mask();
+	if (values.size() == selected.size()) {
+		// view of the whole population
+		selected = values;
+		return;
+	}
+	size_t jj = 0;
+	for (size_t ii = mask.find_first(); ii != mask.npos; ii = mask.find_next(ii), ++jj) {
+		selected[ii] = values[jj];
+	}
+}
+
+boost::dynamic_bitset<> recorded(PopulationView const& view, Variable variable)
+{
+	boost::shared_ptr<Session> const owner = session(view);
+	return getSelection(*owner, view).selected[variable];
+}
+
+void commit()
+{
+	commit(*Session::current());
+}
+
+void commit(PopulationView const& view)
+{
+	commit(*session(view));
+}
+
+void commit(Session& session)
+{
+	selections_type& all = selections(session);
+	for (auto it = all.begin(); it != all.end();) {
+		PopulationPtr const pop = it->second.population.lock();
+		if (!pop) {
+			it = all.erase(it);
+			continue;
+		}
+
+		Selection& s = it->second;
+		for (size_t var = 0; var < NUM_VARIABLES; ++var) {
+			boost::dynamic_bitset<> const changed = s.selected[var] ^ s.committed[var];
+			if (changed.none()) {
+				continue;
+			}
+			setParameter(pop, changed & s.selected[var], static_cast<Variable>(var), true);
+			setParameter(pop, changed & s.committed[var], static_cast<Variable>(var), false);
+			s.committed[var] = s.selected[var];
+		}
+		++it;
+	}
+}
+
+} // recording
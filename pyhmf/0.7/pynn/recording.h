@@ -0,0 +1,63 @@
+#pragma once
+
+#include <string>
+#include <boost/dynamic_bitset.hpp>
+
+namespace euter {
+class Population;
+class PopulationView;
+}
+
+class Session;
+
+/// Recording selection of all populations.
+///
+/// For every population and recordable variable one bitset is kept, so that
+/// selecting cells of a (view of a) population is a single bitwise OR of the
+/// view's mask. The selection is transferred to the "record_*" cell parameters
+/// only on commit(), which touches only cells whose state changed since the
+/// last commit.
+/// The bitsets are authoritative: they start empty, as the recording flags of
+/// new cells, and all writes of the flags from python (set(), tset(), rset()
+/// and cellparams) have to go through record() or assign().
+/// Selections are kept with the session the population was created in,
+/// independent of the session active when they are used, such that commit()
+/// does not touch networks of other sessions.
+namespace recording {
+
+enum Variable
+{
+	SPIKES,
+	V,
+	GSYN,
+	NUM_VARIABLES
+};
+
+/// Resolves the cell parameter name ("record_spikes", "record_v",
+/// "record_gsyn") to the recorded variable.
+/// Returns false if the name does not refer to a recording parameter.
+bool fromParameterName(std::string const& name, Variable& variable);
+
+/// Selects (value == true) or deselects all cells in the view.
+void record(euter::PopulationView const& view, Variable variable, bool value = true);
+
+/// Selects the cells of the view according to values, one per cell of the
+/// view in order.
+void assign(euter::PopulationView const& view,
+            Variable variable,
+            boost::dynamic_bitset<> const& values);
+
+/// Returns the cells of the view's population selected for recording of
+/// variable.
+boost::dynamic_bitset<> recorded(euter::PopulationView const& view, Variable variable);
+
+/// Writes pending changes of the recording selection of the current session
+/// to the cell parameters. Needs to be called before the cell parameters are
+/// read, e.g. before mapping or serialization.
+void commit();
+
+/// Commits the session the view's population was created in.
+void commit(euter::PopulationView const& view);
+void commit(Session& session);
+
+} // recording
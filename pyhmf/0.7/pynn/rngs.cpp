@@ -0,0 +1,137 @@
+#include "rngs.h"
+
+#include <algorithm>
+#include <stdexcept>
+#include <unordered_map>
+#include <boost/weak_ptr.hpp>
+
+#include "pyhmf/objectstore.h"
+
+namespace rngs {
+
+namespace {
+
+struct Entry
+{
+	boost::weak_ptr<void const> owner;
+	std::string identity;
+	std::function<std::string()> get;
+};
+
+struct Registry
+{
+	Registry() : threshold(64)
+	{
+	}
+
+	std::vector<Entry> entries;
+	// size at which expired entries are dropped
+	size_t threshold;
+	// number of RNGs created per identity, including dead ones
+	std::unordered_map<std::string, size_t> created;
+};
+
+void dropExpired(std::vector<Entry>& all)
+{
+	all.erase(std::remove_if(all.begin(), all.end(),
+	                         [](Entry const& e) { return e.owner.expired(); }),
+	          all.end());
+}
+
+} // anonymous namespace
+
+StateWriter::StateWriter(char tag) : mData(1, tag)
+{
+}
+
+void StateWriter::integer(std::uint64_t value)
+{
+	do {
+		char byte = static_cast<char>(value & 0x7f);
+		value >>= 7;
+		if (value) {
+			byte |= static_cast<char>(0x80);
+		}
+		mData.push_back(byte);
+	} while (value);
+}
+
+std::string const& StateWriter::data() const
+{
+	return mData;
+}
+
+StateReader::StateReader(std::string data, char tag) : mData(std::move(data)), mPos(1)
+{
+	if (mData.empty() || mData[0] != tag) {
+		throw std::invalid_argument("State belongs to a different kind of RNG");
+	}
+}
+
+std::uint64_t StateReader::integer()
+{
+	std::uint64_t value = 0;
+	for (size_t shift = 0; shift < 64; shift += 7) {
+		if (mPos >= mData.size()) {
+			throw std::invalid_argument("Truncated RNG state");
+		}
+		std::uint8_t const byte = static_cast<std::uint8_t>(mData[mPos++]);
+		value |= static_cast<std::uint64_t>(byte & 0x7f) << shift;
+		if (!(byte & 0x80)) {
+			return value;
+		}
+	}
+	throw std::invalid_argument("Invalid RNG state");
+}
+
+void StateReader::finish() const
+{
+	if (mPos != mData.size()) {
+		throw std::invalid_argument("Invalid RNG state");
+	}
+}
+
+void add(boost::shared_ptr<void const> const& owner,
+         std::string identity,
+         std::function<std::string()> get)
+{
+	Registry& registry = Session::current()->registry<Registry>();
+	std::vector<Entry>& all = registry.entries;
+
+	// temporary RNGs are created frequently, e.g. as default arguments, drop
+	// them whenever the registry doubled in size
+	if (all.size() >= registry.threshold) {
+		dropExpired(all);
+		registry.threshold = std::max<size_t>(64, 2 * all.size());
+	}
+
+	size_t const count = ++registry.created[identity];
+	if (count > 1) {
+		identity += " #" + std::to_string(count);
+	}
+	Entry const entry = {owner, std::move(identity), std::move(get)};
+	all.push_back(entry);
+}
+
+std::vector<std::pair<std::string, std::string> > states()
+{
+	std::vector<Entry>& all = Session::current()->registry<Registry>().entries;
+	dropExpired(all);
+
+	// get() may run python code, which may create or destroy RNGs, thus the
+	// registry must not be iterated directly
+	std::vector<Entry> const snapshot = all;
+	std::vector<std::pair<std::string, std::string> > result;
+	result.reserve(snapshot.size());
+	for (Entry const& entry : snapshot) {
+		// get() uses raw pointers into the RNG, it has to be kept alive
+		boost::shared_ptr<void const> const keep = entry.owner.lock();
+		if (!keep) {
+			continue;
+		}
+		result.push_back(std::make_pair(entry.identity, entry.get()));
+	}
+	return result;
+}
+
+} // rngs
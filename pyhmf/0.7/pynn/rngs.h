@@ -0,0 +1,95 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+#include <boost/shared_ptr.hpp>
+
+/// States of the RNGs created from python.
+///
+/// A state is a compact byte string: a tag naming the kind of RNG followed by
+/// unsigned integers in LEB128 encoding. Standard engines are stored as the
+/// integers of their textual representation.
+/// All live RNGs are registered in order of creation with the current session,
+/// such that their states can be stored along with its ObjectStore. RNGs are
+/// referenced weakly, the registry does not keep them alive.
+/// Each RNG is identified by its kind and seed as passed to its constructor,
+/// e.g. "CounterRNG(seed=1, stream=2)". Identical identities are numbered in
+/// order of creation within the session when registered: the second is
+/// suffixed by " #2" and so on, independent of which of them are still alive.
+namespace rngs {
+
+class StateWriter
+{
+public:
+	explicit StateWriter(char tag);
+
+	void integer(std::uint64_t value);
+
+	template <typename Engine>
+	void engine(Engine const& engine)
+	{
+		std::ostringstream text;
+		text << engine;
+		std::istringstream in(text.str());
+		std::vector<std::uint64_t> values;
+		std::uint64_t value;
+		while (in >> value) {
+			values.push_back(value);
+		}
+		integer(values.size());
+		for (std::uint64_t v : values) {
+			integer(v);
+		}
+	}
+
+	std::string const& data() const;
+
+private:
+	std::string mData;
+};
+
+class StateReader
+{
+public:
+	/// Throws std::invalid_argument if data is not a state of the given kind.
+	StateReader(std::string data, char tag);
+
+	std::uint64_t integer();
+
+	template <typename Engine>
+	void engine(Engine& engine)
+	{
+		std::uint64_t const count = integer();
+		std::ostringstream text;
+		for (std::uint64_t ii = 0; ii < count; ++ii) {
+			text << integer() << ' ';
+		}
+		std::istringstream in(text.str());
+		if (!(in >> engine)) {
+			throw std::invalid_argument("Invalid RNG state");
+		}
+	}
+
+	/// Throws std::invalid_argument if not all data was read.
+	void finish() const;
+
+private:
+	std::string mData;
+	size_t mPos;
+};
+
+/// Registers a new RNG whose state is returned by get while owner is alive.
+void add(boost::shared_ptr<void const> const& owner,
+         std::string identity,
+         std::function<std::string()> get);
+
+/// Returns the unique identities and states of all live RNGs of the current
+/// session in order of creation.
+std::vector<std::pair<std::string, std::string> > states();
+
+} // rngs
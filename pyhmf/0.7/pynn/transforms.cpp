@@ -0,0 +1,28 @@
+#include "transforms.h"
+
+#include <stdexcept>
+
+namespace transforms {
+
+Uniform::Uniform(double l, double h) : low(l), high(h)
+{
+}
+
+Normal::Normal(double m, double s) : mu(m), sigma(s)
+{
+}
+
+Exponential::Exponential(double s) : scale(s)
+{
+}
+
+Integer::Integer(std::int64_t l, std::int64_t h) :
+	low(l),
+	range(static_cast<std::uint64_t>(h) - static_cast<std::uint64_t>(l) + 1)
+{
+	if (h < l) {
+		throw std::invalid_argument("Empty integer range");
+	}
+}
+
+} // transforms
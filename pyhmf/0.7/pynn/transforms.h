@@ -0,0 +1,95 @@
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+
+/// Transforms of uniformly distributed random bits into values of the
+/// distributions drawn by the pyhmf-side RNGs. Each transform turns two 64 bit
+/// words into two values.
+namespace transforms {
+
+/// Uniform doubles in [low, high)
+struct Uniform
+{
+	typedef double result_type;
+
+	Uniform(double low = 0., double high = 1.);
+
+	void operator()(std::uint64_t a, std::uint64_t b, double* out) const
+	{
+		out[0] = low + (high - low) * toUnit(a);
+		out[1] = low + (high - low) * toUnit(b);
+	}
+
+	/// Maps the upper 53 bits to [0, 1)
+	static double toUnit(std::uint64_t x)
+	{
+		return static_cast<double>(x >> 11) * (1. / 9007199254740992.);
+	}
+
+	double low;
+	double high;
+};
+
+/// Normal distribution, the Box-Muller transform turns both halves of a
+/// block into two values.
+struct Normal
+{
+	typedef double result_type;
+
+	Normal(double mu = 0., double sigma = 1.);
+
+	void operator()(std::uint64_t a, std::uint64_t b, double* out) const
+	{
+		double const r = sigma * std::sqrt(-2. * std::log(1. - Uniform::toUnit(a)));
+		double const phi = 2. * M_PI * Uniform::toUnit(b);
+		out[0] = mu + r * std::cos(phi);
+		out[1] = mu + r * std::sin(phi);
+	}
+
+	double mu;
+	double sigma;
+};
+
+/// Exponential distribution with the given mean (PyNN's beta)
+struct Exponential
+{
+	typedef double result_type;
+
+	explicit Exponential(double scale = 1.);
+
+	void operator()(std::uint64_t a, std::uint64_t b, double* out) const
+	{
+		out[0] = -scale * std::log(1. - Uniform::toUnit(a));
+		out[1] = -scale * std::log(1. - Uniform::toUnit(b));
+	}
+
+	double scale;
+};
+
+/// Uniform integers in [low, high], the 64 bit multiply-shift reduction has
+/// a negligible bias of at most (high - low + 1) / 2^64.
+struct Integer
+{
+	typedef std::int64_t result_type;
+
+	Integer(std::int64_t low, std::int64_t high);
+
+	void operator()(std::uint64_t a, std::uint64_t b, std::int64_t* out) const
+	{
+		out[0] = static_cast<std::int64_t>(static_cast<std::uint64_t>(low) + reduce(a));
+		out[1] = static_cast<std::int64_t>(static_cast<std::uint64_t>(low) + reduce(b));
+	}
+
+	std::uint64_t reduce(std::uint64_t x) const
+	{
+		// range wraps to 0 for the full 64 bit range
+		return range ? static_cast<std::uint64_t>(
+			(static_cast<unsigned __int128>(x) * range) >> 64) : x;
+	}
+
+	std::int64_t low;
+	std::uint64_t range;
+};
+
+} // transforms
@@ -0,0 +1,231 @@
+#include "truncated.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+#include <boost/make_shared.hpp>
+
+namespace truncated {
+
+namespace {
+
+// standard normal CDF, accurate in the lower tail
+inline double normalCDF(double x)
+{
+	return 0.5 * std::erfc(-x / M_SQRT2);
+}
+
+inline double clip(double x, double low, double high)
+{
+	return std::min(std::max(x, low), high);
+}
+
+double parameter(std::vector<double> const& parameters, size_t pos, double value)
+{
+	return pos < parameters.size() ? parameters[pos] : value;
+}
+
+void checkParameters(std::vector<double> const& parameters, size_t max)
+{
+	if (parameters.size() > max) {
+		throw std::invalid_argument("Invalid number of parameters");
+	}
+}
+
+class Uniform : public Sampler
+{
+public:
+	Uniform(double low, double high) : mLow(low), mHigh(high)
+	{
+	}
+
+	virtual void transform(double* values, size_t n) const
+	{
+		for (size_t ii = 0; ii < n; ++ii) {
+			values[ii] = mLow + (mHigh - mLow) * values[ii];
+		}
+	}
+
+private:
+	double mLow;
+	double mHigh;
+};
+
+class Exponential : public Sampler
+{
+public:
+	// The truncated distribution is the exponential one shifted to low,
+	// scaled by the probability of [low, high].
+	Exponential(double beta, double low, double high) :
+		mBeta(beta), mLow(low), mHigh(high), mMass(std::expm1(-(high - low) / beta))
+	{
+	}
+
+	virtual void transform(double* values, size_t n) const
+	{
+		for (size_t ii = 0; ii < n; ++ii) {
+			double const x = mLow - mBeta * std::log1p(values[ii] * mMass);
+			values[ii] = clip(x, mLow, mHigh);
+		}
+	}
+
+private:
+	double mBeta;
+	double mLow;
+	double mHigh;
+	double mMass;
+};
+
+class Normal : public Sampler
+{
+public:
+	// Works on the standardized interval [a, b]. Intervals on the positive
+	// side are mirrored, such that the CDF is evaluated in the lower tail only
+	// where it is accurate.
+	Normal(double mu, double sigma, double low, double high) :
+		mMu(mu), mSigma(sigma), mLow(low), mHigh(high)
+	{
+		double a = (low - mu) / sigma;
+		double b = (high - mu) / sigma;
+		mSign = 1.;
+		if (a > 0.) {
+			std::swap(a, b);
+			a = -a;
+			b = -b;
+			mSign = -1.;
+		}
+
+		mA = a;
+		mB = b;
+		mCDFA = normalCDF(a);
+		mMass = normalCDF(b) - mCDFA;
+
+		// Far in the tail the CDF underflows, there the normal density is
+		// approximated by x exp(-x^2 / 2), whose CDF can be inverted directly.
+		mTail = !(mMass > std::numeric_limits<double>::min());
+		if (mTail) {
+			mMass = -std::expm1(-0.5 * (a * a - b * b));
+		}
+	}
+
+	virtual void transform(double* values, size_t n) const
+	{
+		if (mTail) {
+			// the interval is [a, b] with b < 0, sampled as [-b, -a]
+			for (size_t ii = 0; ii < n; ++ii) {
+				double const z = -std::sqrt(mB * mB - 2. * std::log1p(-values[ii] * mMass));
+				values[ii] = clip(mMu + mSign * mSigma * z, mLow, mHigh);
+			}
+		} else {
+			for (size_t ii = 0; ii < n; ++ii) {
+				double const z = normalQuantile(mCDFA + values[ii] * mMass);
+				values[ii] = clip(mMu + mSign * mSigma * clip(z, mA, mB), mLow, mHigh);
+			}
+		}
+	}
+
+private:
+	double mMu;
+	double mSigma;
+	double mLow;
+	double mHigh;
+	double mSign;
+	double mA;
+	double mB;
+	double mCDFA;
+	double mMass;
+	bool mTail;
+};
+
+} // anonymous namespace
+
+Sampler::~Sampler()
+{
+}
+
+boost::shared_ptr<Sampler const> create(std::string const& distribution,
+                                        std::vector<double> const& parameters,
+                                        double low, double high)
+{
+	if (!(low <= high)) {
+		throw std::invalid_argument("Invalid boundaries");
+	}
+
+	if (distribution == "uniform") {
+		checkParameters(parameters, 2);
+		double const l = std::max(low, parameter(parameters, 0, 0.));
+		double const h = std::min(high, parameter(parameters, 1, 1.));
+		if (!(l <= h)) {
+			throw std::invalid_argument("Boundaries outside of the distribution's support");
+		}
+		return boost::make_shared<Uniform>(l, h);
+	} else if (distribution == "normal") {
+		checkParameters(parameters, 2);
+		double const sigma = parameter(parameters, 1, 1.);
+		if (!(sigma > 0.)) {
+			throw std::invalid_argument("Standard deviation must be positive");
+		}
+		return boost::make_shared<Normal>(parameter(parameters, 0, 0.), sigma, low, high);
+	} else if (distribution == "exponential") {
+		checkParameters(parameters, 1);
+		double const beta = parameter(parameters, 0, 1.);
+		double const l = std::max(low, 0.);
+		if (!(beta > 0.) || !(l <= high)) {
+			throw std::invalid_argument("Boundaries outside of the distribution's support");
+		}
+		return boost::make_shared<Exponential>(beta, l, high);
+	}
+	return boost::shared_ptr<Sampler const>();
+}
+
+// Rational approximation by P. J. Acklam (relative error 1.15e-9), refined by
+// one step of Halley's method to full double precision. Deep in the tail the
+// density underflows, there the approximation is returned unrefined.
+double normalQuantile(double p)
+{
+	static double const a[] = {-3.969683028665376e+01, 2.209460984245205e+02,
+	                           -2.759285104469687e+02, 1.383577518672690e+02,
+	                           -3.066479806614716e+01, 2.506628277459239e+00};
+	static double const b[] = {-5.447609879822406e+01, 1.615858368580409e+02,
+	                           -1.556989798598866e+02, 6.680131188771972e+01,
+	                           -1.328068155288572e+01};
+	static double const c[] = {-7.784894002430293e-03, -3.223964580411365e-01,
+	                           -2.400758277161838e+00, -2.549732539343734e+00,
+	                           4.374664141464968e+00, 2.938163982698783e+00};
+	static double const d[] = {7.784695709041462e-03, 3.224671290700398e-01,
+	                           2.445134137142996e+00, 3.754408661907416e+00};
+	double const split = 0.02425;
+
+	if (p <= 0.) {
+		return -std::numeric_limits<double>::infinity();
+	}
+	if (p >= 1.) {
+		return std::numeric_limits<double>::infinity();
+	}
+
+	double x;
+	if (p < split || p > 1. - split) {
+		double const q = std::sqrt(-2. * std::log(p < split ? p : 1. - p));
+		x = (((((c[0] * q + c[1]) * q + c[2]) * q + c[3]) * q + c[4]) * q + c[5]) /
+		    ((((d[0] * q + d[1]) * q + d[2]) * q + d[3]) * q + 1.);
+		if (p > split) {
+			x = -x;
+		}
+	} else {
+		double const q = p - 0.5;
+		double const r = q * q;
+		x = (((((a[0] * r + a[1]) * r + a[2]) * r + a[3]) * r + a[4]) * r + a[5]) * q /
+		    (((((b[0] * r + b[1]) * r + b[2]) * r + b[3]) * r + b[4]) * r + 1.);
+	}
+
+	// exp(0.5 x^2) overflows beyond
+	if (0.5 * x * x > 700.) {
+		return x;
+	}
+	double const e = normalCDF(x) - p;
+	double const u = e * std::sqrt(2. * M_PI) * std::exp(0.5 * x * x);
+	return x - u / (1. + 0.5 * x * u);
+}
+
+} // truncated
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <vector>
+#include <boost/shared_ptr.hpp>
+
+/// Distributions truncated to an interval [low, high].
+///
+/// Uniform values in [0, 1) are mapped through the inverse CDF of the
+/// truncated distribution, thus every value costs the same independent of the
+/// probability of the interval, in contrast to redrawing values outside.
+namespace truncated {
+
+class Sampler
+{
+public:
+	virtual ~Sampler();
+
+	/// Maps n uniform values in [0, 1) in place to values of the truncated
+	/// distribution.
+	virtual void transform(double* values, size_t n) const = 0;
+};
+
+/// Returns the sampler for the PyNN distribution ("uniform" [low, high],
+/// "normal" [mu, sigma] or "exponential" [beta]) truncated to [low, high], or
+/// a null pointer if the distribution is not supported.
+boost::shared_ptr<Sampler const> create(std::string const& distribution,
+                                        std::vector<double> const& parameters,
+                                        double low, double high);
+
+/// Inverse of the standard normal CDF
+double normalQuantile(double p);
+
+} // truncated
@@ -40,7 +40,8 @@ pynn_classes = '''\
     GutigWeightDependence SpikePairRule \
     DCSource StepCurrentSource ACSource NoisyCurrentSource \
     BaseFile StandardTextFile PickleFile NumpyBinaryFile HDF5ArrayFile \
-    AbstractRNG NumpyRNG GSLRNG NativeRNG RandomDistribution \
+    AbstractRNG NumpyRNG GSLRNG NativeRNG CounterRNG RandomDistribution \
+    Session RunHandle \
     Timer ProgressBar
     '''.split()
 pynn_base_classes = '''\
@@ -53,12 +54,13 @@ pynn_exceptions = '''\
     RecordingError PyHMFException IndexError
     '''.split()
 pynn_functions = '''\
-    setup end run reset \
+    setup end run run_async reset \
     get_time_step get_current_time get_min_delay get_max_delay \
     rank num_processes \
     create connect set initialize record record_v record_gsyn \
     colour notify get_script_args init_logging \
-    dumpAsXml dumpAsBinary \
+    dumpAsXml dumpAsBinary get_population get_projection \
+    get_session default_session \
     '''.split()
 testing_functions = '''\
     numpyExample getObjectStoreSize\
@@ -150,6 +152,10 @@ for cl in pynn_classes + helper_classes:
         c.add_registration_code('def("__iter__", bp::range(&Py{0}::begin, &Py{0}::end))'.format(cl))
         c.add_registration_code('def("all", bp::range(&Py{0}::begin, &Py{0}::end))'.format(cl))
 
+    if cl == 'Session':
+        c.mem_fun('enter').rename('__enter__')
+        c.mem_fun('exit').rename('__exit__')
+
     if cl == 'Projection':
         c.add_property('pre', c.mem_fun('getPre'))
         c.add_property('post', c.mem_fun('getPost'))
@@ -163,7 +169,11 @@ for cl in pynn_classes + helper_classes:
     # FIXME: (ECM) query inherited size() directly
     if cl in ['Population', 'PopulationView']:
         base = findClass('PopulationBase')
-        for fn in ['size', 'label', 'celltype']:
+        for fn in ['size', 'label', 'celltype', 'positions']:
+            # positions() is not provided by all API levels
+            fns = base.mem_funs(fn, allow_empty=True)
+            if len(fns) == 0:
+                continue
             c.add_property(fn, base.mem_fun(fn))
 
     # provide size(void) -> __len__ operator
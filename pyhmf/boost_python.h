@@ -4,6 +4,7 @@
 
 #include <map>
 #include <string>
+#include <type_traits>
 #include <vector>
 
 #include <boost/python/object.hpp>
@@ -21,18 +22,57 @@
 /// Code required to initialize the boost python converters
 void initializeCustomPythonConverters();
 
+/// Checks and converts a single python value to T
+template<typename T>
+struct FromPyValue {
+	static bool check(PyObject * obj) {
+		return bp::extract<T>(obj).check();
+	}
+
+	static T get(PyObject * obj) {
+		return bp::extract<T>(obj);
+	}
+};
+
+template<>
+struct FromPyValue<bp::object> {
+	static bool check(PyObject *) {
+		return true;
+	}
+
+	static bp::object get(PyObject * obj) {
+		return bp::object(bp::handle<>(bp::borrowed(obj)));
+	}
+};
+
+template<>
+struct FromPyValue<double> {
+	static bool check(PyObject * obj) {
+		return PyFloat_Check(obj) || bp::extract<double>(obj).check();
+	}
+
+	static double get(PyObject * obj) {
+		return PyFloat_Check(obj) ? PyFloat_AS_DOUBLE(obj) : bp::extract<double>(obj)();
+	}
+};
+
+/// Converts python dicts with string keys in a single walk over the dict
+/// items. Maps of typed values only accept dicts whose items have matching
+/// types, such that overload resolution can pick another overload. Maps of
+/// python objects accept every dict, invalid keys raise a TypeError during
+/// the conversion.
 template<typename T>
 struct MapFromPyDict {
 	typedef std::map<std::string, T> MyDict;
 
 	static void* convertible(PyObject * obj) {
 		if (!PyDict_Check(obj)) return 0;
-		bp::dict x = bp::dict(bp::object(bp::handle<>(bp::borrowed(obj))));
-		bp::list keys = x.keys();
-		for (int i = 0; i < bp::len(keys); i++) {
-			bp::extract<std::string> key(keys[i]);
-			bp::extract<T> value(x[keys[i]]);
-			if (!(key.check() && value.check()))
+		if (std::is_same<T, bp::object>::value) return obj;
+		PyObject * key;
+		PyObject * value;
+		Py_ssize_t pos = 0;
+		while (PyDict_Next(obj, &pos, &key, &value)) {
+			if (!(bp::extract<std::string>(key).check() && FromPyValue<T>::check(value)))
 				return 0;
 		}
 		return obj;
@@ -41,19 +81,29 @@ struct MapFromPyDict {
 	static void construct(PyObject * obj,
 	                      bp::converter::rvalue_from_python_stage1_data * data) {
 
-		MyDict ret;
-
-		// extract keys and fill map key-wise
-		bp::dict x = bp::dict(bp::object(bp::handle<>(bp::borrowed(obj))));
-
-		bp::list keys = x.keys();
-		for (int i = 0; i < bp::len(keys); i++) {
-			std::string key = bp::extract<std::string>(keys[i]);
-			ret[key] = bp::extract<T>(x[keys[i]]);
-		}
-
 		void * storage = ((bp::converter::rvalue_from_python_storage<MyDict>*)data)->storage.bytes;
-		new (storage) std::map<std::string, T>(ret);
+		MyDict * ret = new (storage) MyDict();
+
+		try {
+			PyObject * key;
+			PyObject * value;
+			Py_ssize_t pos = 0;
+			while (PyDict_Next(obj, &pos, &key, &value)) {
+				bp::extract<std::string> name(key);
+				if (!name.check()) {
+					PyErr_SetString(PyExc_TypeError, "Dict keys must be strings");
+					bp::throw_error_already_set();
+				}
+				if (!FromPyValue<T>::check(value)) {
+					PyErr_SetString(PyExc_TypeError, "Invalid type of dict value");
+					bp::throw_error_already_set();
+				}
+				ret->insert(std::make_pair(std::string(name()), FromPyValue<T>::get(value)));
+			}
+		} catch (...) {
+			ret->~MyDict();
+			throw;
+		}
 
 		data->convertible = storage;
 	}
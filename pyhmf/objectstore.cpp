@@ -1,17 +1,104 @@
 #include "pyhmf/objectstore.h"
 
+#include <algorithm>
+#include <unordered_map>
+#include <boost/weak_ptr.hpp>
+
 using namespace euter;
 
 namespace {
-ObjectStore store;
+// null if the default session is active
+thread_local boost::shared_ptr<Session> active;
+
+struct Owner
+{
+	boost::weak_ptr<void const> object;
+	boost::weak_ptr<Session> session;
+};
+
+typedef std::unordered_map<void const*, Owner> owners_type;
+
+owners_type& owners()
+{
+	static owners_type instance;
+	return instance;
+}
+}
+
+Session::Session()
+{
+}
+
+ObjectStore& Session::store()
+{
+	return mStore;
+}
+
+void Session::reset()
+{
+	mStore = ObjectStore();
+}
+
+boost::shared_ptr<Session> const& Session::defaultSession()
+{
+	static boost::shared_ptr<Session> const instance(new Session);
+	return instance;
+}
+
+boost::shared_ptr<Session> const& Session::current()
+{
+	return active ? active : defaultSession();
+}
+
+boost::shared_ptr<Session> Session::activate(boost::shared_ptr<Session> session)
+{
+	if (session == defaultSession()) {
+		session.reset();
+	}
+	active.swap(session);
+	return session ? session : defaultSession();
+}
+
+void Session::own(boost::shared_ptr<void const> const& object)
+{
+	owners_type& all = owners();
+
+	// drop objects that vanished whenever the map doubled in size
+	static size_t threshold = 64;
+	if (all.size() >= threshold) {
+		for (auto it = all.begin(); it != all.end();) {
+			if (it->second.object.expired()) {
+				it = all.erase(it);
+			} else {
+				++it;
+			}
+		}
+		threshold = std::max<size_t>(64, 2 * all.size());
+	}
+
+	Owner& owner = all[object.get()];
+	owner.object = object;
+	owner.session = current();
+}
+
+boost::shared_ptr<Session> Session::of(void const* object)
+{
+	owners_type const& all = owners();
+	auto const it = all.find(object);
+	if (it != all.end() && !it->second.object.expired()) {
+		if (boost::shared_ptr<Session> const session = it->second.session.lock()) {
+			return session;
+		}
+	}
+	return current();
 }
 
 void resetStore()
 {
-	store = ObjectStore();
+	Session::current()->reset();
 }
 
 ObjectStore& getStore()
 {
-	return store;
+	return Session::current()->store();
 }
@@ -1,6 +1,67 @@
 #pragma once
 
+#include <map>
+#include <typeindex>
+#include <boost/make_shared.hpp>
+#include <boost/shared_ptr.hpp>
+
 #include "euter/objectstore.h"
 
+/// A network with its own ObjectStore and per-network state of the API.
+///
+/// Every thread works on its active session, threads without an active
+/// session share the default one. Thus several networks can be built (and
+/// run) from different threads of a process, objects of a network have to be
+/// used while its session is active, except for state registered with own().
+class Session
+{
+public:
+	Session();
+
+	euter::ObjectStore& store();
+
+	/// Replaces the store by an empty one.
+	void reset();
+
+	/// Per-session instance of T, e.g. the index of labels, created on first
+	/// use.
+	template <typename T>
+	T& registry()
+	{
+		boost::shared_ptr<void>& instance = mRegistries[std::type_index(typeid(T))];
+		if (!instance) {
+			instance = boost::make_shared<T>();
+		}
+		return *static_cast<T*>(instance.get());
+	}
+
+	/// The session shared by all threads without an active session
+	static boost::shared_ptr<Session> const& defaultSession();
+
+	/// The active session of the calling thread
+	static boost::shared_ptr<Session> const& current();
+
+	/// Makes session the active session of the calling thread, null
+	/// activates the default session. Returns the previously active session.
+	static boost::shared_ptr<Session> activate(boost::shared_ptr<Session> session);
+
+	/// Registers object as created in the current session, such that
+	/// per-object state (e.g. recording selections) is kept with its session
+	/// independent of the session active when it is used.
+	static void own(boost::shared_ptr<void const> const& object);
+
+	/// The session object was created in, the current one for objects not
+	/// registered by own() or whose session vanished.
+	static boost::shared_ptr<Session> of(void const* object);
+
+private:
+	Session(Session const&);
+	Session& operator=(Session const&);
+
+	euter::ObjectStore mStore;
+	std::map<std::type_index, boost::shared_ptr<void> > mRegistries;
+};
+
+/// Reset and access the store of the current session
 void resetStore();
 euter::ObjectStore& getStore();
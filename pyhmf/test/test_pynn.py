@@ -49,6 +49,56 @@ class Assembly(unittest.TestCase):
 
         pynn.run(1000)
 
+    def test_GetPopulation(self):
+        pynn.setup()
+
+        p1 = pynn.Population(10, pynn.IF_cond_exp, label="p1")
+        p2 = pynn.Population(20, pynn.IF_cond_exp, label="p2")
+        a = pynn.Assembly(p1, label="a")
+        self.assertEqual(a.get_population("p1").size, 10)
+        with self.assertRaises(KeyError):
+            a.get_population("p2")
+        a += p2
+
+        self.assertEqual(a.get_population("p1").size, 10)
+        self.assertEqual(a.get_population("p2").size, 20)
+        with self.assertRaises(KeyError):
+            a.get_population("p3")
+
+        self.assertEqual(pynn.get_population("p2").size, 20)
+        proj = pynn.Projection(p1, p2, pynn.AllToAllConnector(), label="proj")
+        self.assertEqual(pynn.get_projection("proj").euter_id(), proj.euter_id())
+
+        pynn.setup()
+        with self.assertRaises(KeyError):
+            pynn.get_population("p1")
+
+    def test_IdToIndex(self):
+        import numpy
+        pynn.setup()
+
+        p1 = pynn.Population(10, pynn.IF_cond_exp)
+        p2 = pynn.Population(20, pynn.IF_cond_exp)
+        view = p2[::3]
+
+        self.assertEqual(p1.id_to_index(p1[5]), 5)
+        self.assertEqual(view.id_to_index(view[4]), 4)
+        self.assertEqual(list(p2.id_to_index([p2[1], p2[7]])), [1, 7])
+
+        a = pynn.Assembly(view, p1)
+        ids = numpy.array([int(cell) for cell in a])
+        numpy.testing.assert_array_equal(a.id_to_index(ids[::-1]), numpy.arange(len(a))[::-1])
+        numpy.testing.assert_array_equal(a.id_to_index(ids.astype(numpy.int32)),
+                                         numpy.arange(len(a)))
+        self.assertEqual([a.id_to_index(cell) for cell in a], list(range(len(a))))
+
+        with self.assertRaises(IndexError):
+            view.id_to_index(numpy.array([int(p2[1])]))
+        with self.assertRaises(TypeError):
+            view.id_to_index(numpy.array([1.0]))
+        with self.assertRaises(IndexError):
+            a.id_to_index(p2[1])
+
 
 @unittest.skipIf(not pymarocco_available(), "Test requires pymarocco")
 class PopulationView(unittest.TestCase):
@@ -99,6 +149,193 @@ class PopulationView(unittest.TestCase):
         all_spike_times_numpy = numpy.array(all_spike_times)
         pop.tset('spike_times', all_spike_times_numpy)
 
+    def test_SetDict(self):
+        pynn.setup()
+
+        pop = pynn.Population(10, pynn.IF_cond_exp)
+        view = pop[2:5]
+        view.set({'tau_m': 12, 'v_rest': -61.5, 'record_spikes': True})
+        self.assertEqual(view.get('tau_m'), [12.] * 3)
+        self.assertEqual(view.get('v_rest'), [-61.5] * 3)
+        self.assertEqual(pop.get('record_spikes')[2:5], [True] * 3)
+        self.assertNotEqual(pop.get('tau_m')[0], 12.)
+
+        with self.assertRaises(TypeError):
+            view.set({1: 12.})
+
+    def test_ConstructorDtypes(self):
+        import numpy
+        pynn.setup()
+
+        N = 100
+        pop = pynn.Population(N, pynn.IF_cond_exp)
+        selector = numpy.random.rand(N) < 0.3
+        indices = numpy.flatnonzero(selector)
+
+        numpy.testing.assert_array_equal(
+            pynn.PopulationView(pop, selector).mask(), indices)
+        for dtype in [numpy.int8, numpy.uint16, numpy.int32, numpy.uint64]:
+            numpy.testing.assert_array_equal(
+                pynn.PopulationView(pop, indices.astype(dtype)).mask(), indices)
+        numpy.testing.assert_array_equal(
+            pynn.PopulationView(pop, tuple(indices)).mask(), indices)
+
+        for bad in [numpy.array([N]), numpy.array([-1]), numpy.array([N], dtype=numpy.int32)]:
+            with self.assertRaises(RuntimeError):
+                pynn.PopulationView(pop, bad)
+        with self.assertRaises(RuntimeError):
+            pynn.PopulationView(pop, numpy.array([1.5]))
+
+    def test_Sample(self):
+        import numpy
+        pynn.setup()
+
+        pop = pynn.Population(1000, pynn.IF_cond_exp)
+        for n in [0, 1, 10, 600, 1000]:
+            self.assertEqual(len(pop.sample(n)), n)
+
+        # sampling from a view only selects its cells
+        view = pop[::3]
+        sample = view.sample(100, pynn.NativeRNG(42))
+        self.assertEqual(len(sample), 100)
+        self.assertTrue(numpy.all(sample.mask() % 3 == 0))
+        numpy.testing.assert_array_equal(
+            sample.mask(), view.sample(100, pynn.NativeRNG(42)).mask())
+
+        with self.assertRaises(pynn.InvalidParameterValueError):
+            view.sample(len(view) + 1)
+
+    def test_SetOperations(self):
+        import numpy
+        pynn.setup()
+
+        pop = pynn.Population(10, pynn.IF_cond_exp)
+        a = pop[0:6]
+        b = pop[::2]
+        numpy.testing.assert_array_equal((a & b).mask(), [0, 2, 4])
+        numpy.testing.assert_array_equal((a | b).mask(), [0, 1, 2, 3, 4, 5, 6, 8])
+        numpy.testing.assert_array_equal((a - b).mask(), [1, 3, 5])
+        numpy.testing.assert_array_equal((a ^ b).mask(), [1, 3, 5, 6, 8])
+
+        other = pynn.Population(10, pynn.IF_cond_exp)
+        with self.assertRaises(ValueError):
+            a & other[0:6]
+
+
+class Recording(unittest.TestCase):
+
+    def test_RecordView(self):
+        pynn.setup()
+
+        N = 10
+        pop = pynn.Population(N, pynn.IF_cond_exp)
+        pv = pynn.PopulationView(pop, [1, 3, 5])
+
+        pv.record()
+        self.assertEqual(pop.get('record_spikes'),
+                [ii in [1, 3, 5] for ii in range(N)])
+        self.assertEqual(pop.get('record_v'), [False] * N)
+
+        # recording twice does not change the selection
+        pop[4:6].record()
+        pv.record()
+        self.assertEqual(pop.get('record_spikes'),
+                [ii in [1, 3, 4, 5] for ii in range(N)])
+
+        pop.set('record_v', True)
+        pv.set('record_v', False)
+        self.assertEqual(pop.get('record_v'),
+                [ii not in [1, 3, 5] for ii in range(N)])
+
+
+class CurrentSource(unittest.TestCase):
+
+    def test_InjectIntoIndices(self):
+        import numpy
+        pynn.setup()
+
+        pop = pynn.Population(10, pynn.IF_cond_exp)
+        ids = [int(cell) for cell in pop]
+
+        def targets(source):
+            return sorted(ids.index(id) for id in source.cell_list())
+
+        source = pynn.DCSource(amplitude=0.5)
+        source.inject_into(pop, numpy.array([1, 3, 5]))
+        self.assertEqual(targets(source), [1, 3, 5])
+
+        source = pynn.DCSource(amplitude=0.5)
+        source.inject_into(pop[2:8], numpy.array([0, 5]))
+        self.assertEqual(targets(source), [2, 7])
+
+        source = pynn.DCSource(amplitude=0.5)
+        source.inject_into(pynn.Assembly(pop), numpy.array([ids[4], ids[9]]))
+        self.assertEqual(targets(source), [4, 9])
+
+        # any integer dtype and plain lists are accepted
+        for dtype in (numpy.int32, numpy.uint16, numpy.int64):
+            source = pynn.DCSource(amplitude=0.5)
+            source.inject_into(pop[2:8], numpy.array([1, 2], dtype=dtype))
+            self.assertEqual(targets(source), [3, 4])
+        source = pynn.DCSource(amplitude=0.5)
+        source.inject_into(pynn.Assembly(pop), numpy.array([ids[0]], dtype=numpy.int32))
+        self.assertEqual(targets(source), [0])
+        source = pynn.DCSource(amplitude=0.5)
+        source.inject_into(pop, [6])
+        self.assertEqual(targets(source), [6])
+        with self.assertRaises(TypeError):
+            source.inject_into(pop, numpy.array([1.5]))
+
+        source = pynn.DCSource(amplitude=0.5)
+        with self.assertRaises(IndexError):
+            source.inject_into(pop, numpy.array([10]))
+        with self.assertRaises(IndexError):
+            source.inject_into(pop[2:8], numpy.array([6], dtype=numpy.int32))
+        with self.assertRaises(IndexError):
+            source.inject_into(pop[2:8], numpy.array([-1]))
+        with self.assertRaises(IndexError):
+            source.inject_into(pynn.Assembly(pop[0:5]), numpy.array([ids[7]]))
+        # failed injections don't target any cell
+        self.assertEqual(len(source.cell_list()), 0)
+
+    def test_StepCurrentSource(self):
+        import numpy
+        pynn.setup()
+
+        times = numpy.arange(0., 1000., 0.1)
+        pynn.StepCurrentSource(times, numpy.sin(times))
+        pynn.StepCurrentSource(times[::2], numpy.sin(times)[::2])
+        pynn.StepCurrentSource([10., 20., 30.], [1, 2, 3])
+
+        with self.assertRaises(pynn.InvalidDimensionsError):
+            pynn.StepCurrentSource([10., 20., 30.], [0.1, 0.2])
+
+    def test_NoisyCurrentSource(self):
+        import numpy
+        pynn.setup()
+
+        mean, stdev = 0.5, 0.2
+        s1 = pynn.NoisyCurrentSource(mean, stdev, dt=0.1, start=0., stop=1000.,
+                rng=pynn.NativeRNG(42))
+        s2 = pynn.NoisyCurrentSource(mean, stdev, dt=0.1, start=0., stop=1000.,
+                rng=pynn.NativeRNG(42))
+        s3 = pynn.NoisyCurrentSource(mean, stdev, dt=0.1, start=0., stop=1000.,
+                rng=pynn.NativeRNG(43))
+
+        trace = s1.trace()
+        self.assertEqual(len(trace), 10000)
+        self.assertAlmostEqual(numpy.mean(trace), mean, places=1)
+        self.assertAlmostEqual(numpy.std(trace), stdev, places=1)
+        numpy.testing.assert_array_equal(trace, s2.trace())
+        self.assertFalse(numpy.array_equal(trace, s3.trace()))
+
+        # rounding noise of (stop - start) / dt must not add a step
+        s4 = pynn.NoisyCurrentSource(mean, stdev, dt=0.01, start=0., stop=0.07,
+                rng=pynn.NativeRNG(42))
+        self.assertEqual(len(s4.trace()), 7)
+
+        self.assertEqual(len(pynn.NoisyCurrentSource(mean, stdev).trace()), 0)
+
 
 class Connector(unittest.TestCase):
 
@@ -129,6 +366,68 @@ class Projection(unittest.TestCase):
         pynn.run(100)
 
 
+@unittest.skipIf(not pymarocco_available(), "Test requires pymarocco")
+class RunAsync(unittest.TestCase):
+
+    def test_RunAsync(self):
+        import pymarocco
+
+        marocco = pymarocco.PyMarocco()
+        marocco.calib_backend = pymarocco.PyMarocco.CalibBackend.Default
+
+        pynn.setup(marocco=marocco)
+        pop = pynn.Population(10, pynn.IF_cond_exp)
+
+        handle = pynn.run_async(100)
+        # the next network can be built meanwhile
+        with pynn.Session():
+            pynn.setup()
+            pynn.Population(20, pynn.IF_cond_exp)
+        self.assertTrue(handle.wait())
+        self.assertTrue(handle.done())
+        self.assertEqual(handle.simtime(), 100)
+        self.assertEqual(handle.result(), 1)
+        self.assertEqual(handle.result(0.0), 1)
+
+
+class Sessions(unittest.TestCase):
+
+    def test_Sessions(self):
+        import threading
+        pynn.setup()
+        p1 = pynn.Population(10, pynn.IF_cond_exp, label="p")
+
+        session = pynn.Session()
+        self.assertNotEqual(session, pynn.get_session())
+        with session as s:
+            self.assertEqual(s, pynn.get_session())
+            pynn.setup()
+            p2 = pynn.Population(20, pynn.IF_cond_exp, label="p")
+            self.assertEqual(pynn.get_population("p").size, 20)
+        self.assertEqual(pynn.get_session(), pynn.default_session())
+        self.assertEqual(pynn.get_population("p").size, 10)
+
+        # the recording selection is kept with the population's session
+        with session:
+            p2.record()
+        self.assertEqual(p2.get('record_spikes'), [True] * 20)
+        p1[0:2].record()
+        with session:
+            self.assertEqual(p1.get('record_spikes'), [True] * 2 + [False] * 8)
+
+        # other threads use the default session unless they activate one
+        sizes = []
+        def lookup():
+            sizes.append(pynn.get_population("p").size)
+            session.activate()
+            sizes.append(pynn.get_population("p").size)
+        thread = threading.Thread(target=lookup)
+        thread.start()
+        thread.join()
+        self.assertEqual(sizes, [10, 20])
+        self.assertEqual(pynn.get_session(), pynn.default_session())
+
+
 class Regressions(unittest.TestCase):
 
     def test_CellTypeInitialization(self):
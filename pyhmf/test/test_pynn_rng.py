@@ -22,6 +22,35 @@ class PyRandom(unittest.TestCase):
         data2 = data2[data2 >= 20]
         self.assertEqual(len(data2), 0)
         
+    def test_distribution_truncated(self):
+        import pyhmf as pynn
+        pynn.setup()
+
+        # far in the tail redrawing would practically never terminate
+        for distribution, parameters, bounds in (
+                ("normal", [0.0, 1.0], (8.0, 8.5)),
+                # the density underflows while the CDF does not yet
+                ("normal", [0.0, 1.0], (-39.0, -37.5)),
+                ("normal", [-65.0, 2.0], (-90.0, -80.0)),
+                ("exponential", [2.0], (30.0, 31.0)),
+                ("uniform", [0.0, 10.0], (2.0, 20.0))):
+            d = pynn.RandomDistribution(distribution, parameters, pynn.NativeRNG(1),
+                                        bounds, "redraw")
+            data = d.next(10000)
+            self.assertFalse(numpy.any(numpy.isnan(data)))
+            self.assertGreaterEqual(data.min(), bounds[0])
+            self.assertLessEqual(data.max(), bounds[1])
+
+        d = pynn.RandomDistribution("normal", [0.0, 1.0], pynn.NativeRNG(1), (2.0, 3.0), "redraw")
+        # E[X | 2 <= X <= 3] for a standard normal X
+        self.assertAlmostEqual(numpy.mean(d.next(100000)), 2.3158, places=2)
+
+        p = pynn.Population(50, pynn.IF_cond_exp)
+        p.rset("v_reset", pynn.RandomDistribution("normal", [-70.0, 1.0], pynn.NativeRNG(2),
+                                                  (-60.0, -59.0), "redraw"))
+        self.assertGreaterEqual(min(p.get("v_reset")), -60.0)
+        self.assertLessEqual(max(p.get("v_reset")), -59.0)
+
     def test_normaldistribution(self):
         import pyhmf as pynn
         pynn.setup()
@@ -66,5 +95,225 @@ class PyRandom(unittest.TestCase):
         self.assertEqual(rng.next(
             distribution = "binomial", parameters = [100, 1.]), 100)
 
+    def test_distribution_next(self):
+        import pyhmf as pynn
+        pynn.setup()
+
+        d = pynn.RandomDistribution("randint", [0, 5], pynn.NativeRNG(1))
+        value = d.next()
+        self.assertTrue(0 <= value <= 5)
+        self.assertEqual(len(d.next(20)), 20)
+
+        reference = pynn.RandomDistribution("uniform", [0.0, 1.0], pynn.NativeRNG(2)).next(50)
+        d = pynn.RandomDistribution("uniform", [0.0, 1.0], pynn.NativeRNG(2))
+        out = numpy.zeros(50)
+        self.assertIs(d.next(out=out), out)
+        assert_array_equal(out, reference)
+
+        with self.assertRaises(ValueError):
+            d.next(out=numpy.zeros(50, dtype=numpy.float32))
+        with self.assertRaises(ValueError):
+            d.next(out=numpy.zeros(100)[::2])
+        with self.assertRaises(ValueError):
+            d.next(out=[0.0] * 50)
+
+        # scratch buffers are released after large draws
+        d = pynn.RandomDistribution("uniform", [0.0, 1.0], pynn.NativeRNG(2))
+        self.assertEqual(len(d.next(200000)), 200000)
+        self.assertEqual(len(d.next(10)), 10)
+
+    def test_permutation_shuffle(self):
+        import pyhmf as pynn
+        pynn.setup()
+
+        p = pynn.NativeRNG(3).permutation(1000)
+        assert_array_equal(numpy.sort(p), numpy.arange(1000))
+        self.assertFalse(numpy.all(p == numpy.arange(1000)))
+
+        a = numpy.arange(1000)
+        pynn.NativeRNG(3).shuffle(a)
+        assert_array_equal(a, p)
+
+        # rows are moved as a whole
+        m = numpy.arange(30.).reshape(10, 3)
+        pynn.NativeRNG(3).shuffle(m)
+        assert_array_equal(m[:, 0], 3. * pynn.NativeRNG(3).permutation(10))
+        assert_array_equal(m[:, 1], m[:, 0] + 1)
+
+        with self.assertRaises((ValueError, BufferError)):
+            pynn.NativeRNG(3).shuffle(numpy.arange(10)[::2])
+
+        self.assertEqual(sorted(pynn.NativeRNG(3).permutation([3, 1, 2])), [1, 2, 3])
+
+    def test_counter_rng(self):
+        import pyhmf as pynn
+        pynn.setup()
+
+        values = pynn.CounterRNG(42).next(100, "normal", [1.0, 2.0])
+
+        # values only depend on seed, stream and position
+        rng = pynn.CounterRNG(42)
+        assert_array_equal(numpy.concatenate(
+            [rng.next(3, "normal", [1.0, 2.0]), rng.next(97, "normal", [1.0, 2.0])]),
+            values)
+        self.assertEqual(rng.position(), 100)
+        positions = numpy.array([99, 3, 4, 0, 3])
+        assert_array_equal(rng.at(positions, "normal", [1.0, 2.0]), values[positions])
+        self.assertEqual(rng.position(), 100)
+
+        rng.seek(10)
+        self.assertEqual(rng.next(1, "normal", [1.0, 2.0]), values[10])
+
+        other = pynn.CounterRNG(42, 1).next(100, "normal", [1.0, 2.0])
+        self.assertFalse(numpy.any(other == values))
+
+        rng = pynn.CounterRNG(7)
+        data = rng.next(100000, "uniform", [2.0, 3.0])
+        self.assertGreaterEqual(data.min(), 2.0)
+        self.assertLess(data.max(), 3.0)
+        self.assertAlmostEqual(numpy.mean(rng.next(100000, "exponential", [4.0])), 4.0, places=1)
+        data = rng.next(1000, "randint", [-2, 2])
+        assert_array_equal(numpy.unique(data), numpy.arange(-2, 3))
+
+        with self.assertRaises(ValueError):
+            rng.next(10, "binomial", [10, 0.5])
+
+        d = pynn.RandomDistribution("uniform", [0.0, 1.0], pynn.CounterRNG(3))
+        assert_array_equal(d.next(10),
+            pynn.RandomDistribution("uniform", [0.0, 1.0], pynn.CounterRNG(3)).next(10))
+
+    def test_numpy_rng(self):
+        import pyhmf as pynn
+        pynn.setup()
+
+        # seeded as numpy.random.RandomState
+        rng = pynn.NumpyRNG(5)
+        reference = numpy.random.RandomState(5)
+        assert_array_equal(rng.next(100, "uniform", [0.0, 1.0]),
+                           reference.random_sample(100))
+        self.assertEqual(rng.next(), reference.random_sample())
+        self.assertIsInstance(rng.bit_generator(), numpy.random.MT19937)
+
+        data = rng.next(100000, "normal", [3.0, 0.5])
+        self.assertAlmostEqual(numpy.mean(data), 3.0, places=1)
+        self.assertAlmostEqual(numpy.std(data), 0.5, places=1)
+
+        assert_array_equal(pynn.NumpyRNG(7).next(10, "randint", [1, 6]),
+                           pynn.NumpyRNG(7).next(10, "randint", [1, 6]))
+        # unlike numpy, high is included
+        self.assertEqual(set(pynn.NumpyRNG(7).next(1000, "randint", [1, 6])),
+                         set(range(1, 7)))
+
+        d = pynn.RandomDistribution("uniform", [0.0, 1.0], pynn.NumpyRNG(3))
+        assert_array_equal(d.next(10),
+            pynn.RandomDistribution("uniform", [0.0, 1.0], pynn.NumpyRNG(3)).next(10))
+
+    def test_gsl_rng(self):
+        import pyhmf as pynn
+        pynn.setup()
+
+        # gsl_rng_mt19937 with the default seed 4357 has the value 1186927261
+        # at the 1000th draw (from GSL's own tests)
+        rng = pynn.GSLRNG(4357)
+        rng.next(999, "randint", [0, 4294967294])
+        self.assertEqual(rng.next(1, "uniform", [0.0, 4294967296.0]), 1186927261)
+
+        assert_array_equal(pynn.GSLRNG(0).next(10), pynn.GSLRNG(4357).next(10))
+        self.assertEqual(pynn.GSLRNG(12).seed(), 12)
+
+        rng = pynn.GSLRNG(1)
+        data = rng.next(100000, "normal", [3.0, 0.5])
+        self.assertAlmostEqual(numpy.mean(data), 3.0, places=1)
+        self.assertAlmostEqual(numpy.std(data), 0.5, places=1)
+        data = rng.next(1000, "randint", [-2, 2])
+        assert_array_equal(numpy.unique(data), numpy.arange(-2, 3))
+
+    def test_mask_local_and_spawn(self):
+        import pyhmf as pynn
+        pynn.setup()
+
+        mask = numpy.array([True, False, False, True, True, False])
+        for make in (pynn.NativeRNG, pynn.CounterRNG, pynn.NumpyRNG, pynn.GSLRNG):
+            full = make(11).next(6, "uniform", [0.0, 1.0])
+            rng = make(11)
+            assert_array_equal(rng.next(6, "uniform", [0.0, 1.0], mask), full[mask])
+            assert_array_equal(rng.next(6, "uniform", [0.0, 1.0], False),
+                               make(11).next(12, "uniform", [0.0, 1.0])[6:])
+
+            children = make(11).spawn(3)
+            self.assertEqual(len(children), 3)
+            values = [c.next(5, "uniform", [0.0, 1.0]) for c in children]
+            self.assertFalse(numpy.any(values[0] == values[1]))
+            assert_array_equal(values[2],
+                make(11).spawn(3)[2].next(5, "uniform", [0.0, 1.0]))
+
+        with self.assertRaises(ValueError):
+            pynn.CounterRNG(1).next(3, "uniform", [0.0, 1.0], mask)
+
+        # nested spawning yields new streams
+        for make in (pynn.CounterRNG, pynn.NumpyRNG):
+            children = make(11).spawn(2)
+            grandchild = make(11).spawn(2)[0].spawn(1)[0]
+            self.assertFalse(numpy.any(grandchild.next(5) == children[1].next(5)))
+
+        # masked values are skipped without changing the stream
+        for distribution, parameters in (("uniform", [0.0, 1.0]), ("exponential", [2.0]),
+                                         ("normal", [0.0, 1.0]), ("randint", [0, 9])):
+            rng = pynn.GSLRNG(4)
+            assert_array_equal(rng.next(6, distribution, parameters, mask),
+                               pynn.GSLRNG(4).next(6, distribution, parameters)[mask])
+            assert_array_equal(rng.next(3, distribution, parameters),
+                               pynn.GSLRNG(4).next(9, distribution, parameters)[6:])
+
+    def test_dump_states(self):
+        import struct, tempfile
+        import pyhmf as pynn
+        pynn.setup()
+
+        a = pynn.CounterRNG(1, 2)
+        b = pynn.CounterRNG(1, 2)
+        c = pynn.NativeRNG(3)
+        c.next(5)
+        # numbering follows creation, not the RNGs alive when dumping
+        del b
+        d = pynn.CounterRNG(1, 2)
+        d.next(3)
+
+        with tempfile.NamedTemporaryFile() as f:
+            pynn.dumpAsBinary(f.name)
+            with open(f.name, "rb") as dump:
+                data = dump.read()
+
+        # (identity, state) pairs of strings, each prefixed by its length
+        for identity, rng in ((b"CounterRNG(seed=1, stream=2)", a),
+                              (b"CounterRNG(seed=1, stream=2) #3", d),
+                              (b"NativeRNG(seed=3)", c)):
+            state = rng.get_state()
+            self.assertIn(identity + struct.pack("=Q", len(state)) + state, data)
+        self.assertNotIn(b"CounterRNG(seed=1, stream=2) #2", data)
+
+    def test_get_set_state(self):
+        import pyhmf as pynn
+        pynn.setup()
+
+        for make in (pynn.NativeRNG, pynn.CounterRNG, pynn.NumpyRNG, pynn.GSLRNG):
+            rng = make(5)
+            rng.next(17, "normal", [0.0, 1.0])
+            state = rng.get_state()
+            self.assertIsInstance(state, bytes)
+            expected = rng.next(10, "uniform", [0.0, 1.0])
+            children = rng.spawn(2)
+
+            other = make(7)
+            other.set_state(state)
+            assert_array_equal(other.next(10, "uniform", [0.0, 1.0]), expected)
+            assert_array_equal(other.spawn(2)[1].next(4), children[1].next(4))
+
+            with self.assertRaises(ValueError):
+                other.set_state(state[:-1])
+
+        with self.assertRaises(ValueError):
+            pynn.CounterRNG(1).set_state(pynn.GSLRNG(1).get_state())
+
 if __name__ == '__main__':
     unittest.main()
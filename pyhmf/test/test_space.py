@@ -1,6 +1,9 @@
 #! /usr/bin/python
 # -*- coding: utf-8 -*-
 
+import os
+import shutil
+import tempfile
 import unittest
 
 import numpy as np
@@ -86,5 +89,142 @@ class SpaceTest(unittest.TestCase):
                 )
 
 
+    def test_distances_expand(self):
+
+        A = np.random.rand(3, 100)
+        B = np.random.rand(3, 80)
+
+        space = pyhmf.Space(axes='xz', periodic_boundaries=((0, 1), None, (0, 1)))
+        d = space.distances(A, B, expand=True)
+        self.assertEqual(d.shape, (2, 100, 80))
+        np.testing.assert_almost_equal(
+                np.sqrt(np.sum(d**2, axis=0)),
+                space.distances(A, B))
+
+
+    def test_distances_float32(self):
+
+        A = np.random.rand(3, 100)
+        B = np.random.rand(3, 100)
+
+        d = pyhmf.Space(scale_factor=42.).distances(A, B, dtype="float32")
+        self.assertEqual(d.dtype, np.float32)
+        np.testing.assert_allclose(
+                d, pyhmf.Space(scale_factor=42.).distances(A, B), rtol=1e-6)
+
+
+    def test_distances_single_position(self):
+
+        A = np.random.rand(3)
+        B = np.random.rand(3, 100)
+
+        self.assertEqual(pyhmf.Space().distances(A, B).shape, (1, 100))
+        with self.assertRaises(pyhmf.InvalidDimensionsError):
+            pyhmf.Space().distances(np.random.rand(2, 10), B)
+
+
+    def test_distance_tiles(self):
+
+        A = np.random.rand(3, 100)
+        B = np.random.rand(3, 70)
+
+        space = pyhmf.Space(scale_factor=2., periodic_boundaries=((0, 1), None, (0, 1)))
+        d = np.zeros((100, 70))
+        def collect(i, j, tile):
+            d[i:i+tile.shape[0], j:j+tile.shape[1]] = tile
+        space.distance_tiles(A, B, collect, 32, 16)
+
+        np.testing.assert_equal(d, space.distances(A, B))
+
+
+    def test_pairs_within(self):
+
+        A = np.random.rand(3, 300)
+        B = np.random.rand(3, 5000)
+
+        space = pyhmf.Space()
+        ii, jj, dd = space.pairs_within(A, B, 0.2)
+
+        d = space.distances(A, B)
+        expected = np.nonzero(d <= 0.2)
+        np.testing.assert_equal(ii, expected[0])
+        np.testing.assert_equal(jj, expected[1])
+        np.testing.assert_equal(dd, d[expected])
+
+
+    def test_population_positions(self):
+        pyhmf.setup()
+
+        p = pyhmf.Population(20, pyhmf.IF_cond_exp,
+                structure=pyhmf.Grid2D(fill_order="random"))
+        positions = p.positions
+        self.assertEqual(positions.shape, (3, 20))
+        self.assertFalse(positions.flags.writeable)
+
+        # positions are generated only once
+        np.testing.assert_equal(positions, p.positions)
+        np.testing.assert_equal(positions[:, [2, 5, 7]], p[[2, 5, 7]].positions)
+
+    def test_nearest(self):
+        pyhmf.setup()
+
+        p = pyhmf.Population(100, pyhmf.IF_cond_exp,
+                structure=pyhmf.Grid2D(fill_order="random"))
+        positions = p.positions
+        points = np.random.uniform(-1, 11, (3, 50))
+        distances = np.sqrt(((positions[:, :, None] - points[:, None, :])**2).sum(axis=0))
+
+        nearest = np.argmin(distances, axis=0)
+        self.assertEqual(int(p.nearest(points[:, 0])), int(p[int(nearest[0])]))
+        np.testing.assert_equal(p.nearest_indices(points)[:, 0], nearest)
+
+        k_nearest = p.nearest_indices(points, 4)
+        self.assertEqual(k_nearest.shape, (50, 4))
+        np.testing.assert_equal(np.sort(distances, axis=0)[:4].T,
+                distances[k_nearest, np.arange(50)[:, None]])
+        self.assertEqual(list(p.nearest_k(points[:, 0], 4).mask()),
+                sorted(k_nearest[0]))
+
+        within = p.all_within_distance(points, 1.5)
+        self.assertEqual(len(within), 50)
+        for ii, view in enumerate(within):
+            np.testing.assert_equal(view.mask(), np.flatnonzero(distances[:, ii] <= 1.5))
+        np.testing.assert_equal(p.within_distance(points[:, 0], 1.5).mask(), within[0].mask())
+
+        # queries on a view only consider its cells
+        view = p[::2]
+        view_distances = distances[::2]
+        np.testing.assert_equal(view.nearest_indices(points)[:, 0],
+                np.argmin(view_distances, axis=0))
+        self.assertEqual(int(view.nearest(points[:, 0])),
+                int(view[int(np.argmin(view_distances[:, 0]))]))
+
+    def test_save_positions(self):
+        pyhmf.setup()
+
+        p1 = pyhmf.Population(10, pyhmf.IF_cond_exp,
+                structure=pyhmf.Grid2D(fill_order="random"))
+        p2 = pyhmf.Population(5, pyhmf.IF_cond_exp)
+        a = pyhmf.Assembly(p1[2:7], p2)
+
+        expected = np.empty((10, 4))
+        expected[:5, 0] = [int(p1[ii]) for ii in range(2, 7)]
+        expected[5:, 0] = [int(p2[ii]) for ii in range(5)]
+        expected[:5, 1:] = p1.positions[:, 2:7].T
+        expected[5:, 1:] = p2.positions.T
+
+        directory = tempfile.mkdtemp()
+        try:
+            text = os.path.join(directory, "positions.txt")
+            a.save_positions(text)
+            np.testing.assert_equal(np.loadtxt(text), expected)
+
+            binary = os.path.join(directory, "positions.npy")
+            a.save_positions(binary, True)
+            np.testing.assert_equal(np.load(binary), expected)
+        finally:
+            shutil.rmtree(directory)
+
+
 if __name__ == '__main__':
     unittest.main()
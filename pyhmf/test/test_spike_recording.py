@@ -102,5 +102,36 @@ class TestSpikeRecording(unittest.TestCase):
         s_a = s_a[np.argsort(s_a[:,1])] # sort by time
         self.assertTrue( np.array_equal(list(range(10,20))+list(range(5)), s_a[:,0]) )
 
+    def test_record_flags_without_record(self):
+        """
+        spikes are read back for cells whose record_spikes flag was set
+        without record()
+        """
+
+        import pymarocco
+
+        marocco = pymarocco.PyMarocco()
+        marocco.backend = pymarocco.PyMarocco.ESS
+        marocco.experiment_time_offset = 5.e-7
+        marocco.continue_despite_synapse_loss = True
+        marocco.calib_backend = pymarocco.PyMarocco.CalibBackend.Default
+        marocco.defects.backend = pymarocco.Defects.Backend.Without
+        marocco.hicann_configurator = pysthal.HICANNConfigurator()
+
+        pynn.setup(marocco=marocco)
+
+        p_dummy = pynn.Population(10, pynn.IF_cond_exp)
+        p1 = pynn.Population(10, pynn.SpikeSourceArray,
+                             {'spike_times': [5., 10.]})
+        recorded = np.arange(10) % 2 == 0
+        p1.tset('record_spikes', recorded)
+        pynn.Projection(p1, p_dummy, pynn.OneToOneConnector())
+
+        pynn.run(25.)
+
+        spikes = p1.getSpikes()
+        self.assertEqual(set(spikes[:,0]), set(np.flatnonzero(recorded)))
+        self.assertEqual(list(p1.get_spike_counts()), list(2 * recorded))
+
 if __name__ == '__main__':
     unittest.main()